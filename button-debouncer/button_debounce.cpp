@@ -101,11 +101,13 @@ int Debounce::debounce_gpio(uint gpio)
     {
         offset[gpio] = offset[pio0_already_set];
         conf[gpio] = conf[pio0_already_set];
+        nominal_clkdiv[gpio] = nominal_clkdiv[pio0_already_set];
     }
     else if ((pio_debounced[gpio] == pio1) && (pio1_already_set != UNUSED))
     {
         offset[gpio] = offset[pio1_already_set];
         conf[gpio] = conf[pio1_already_set];
+        nominal_clkdiv[gpio] = nominal_clkdiv[pio1_already_set];
     }
     else
     {
@@ -114,7 +116,8 @@ int Debounce::debounce_gpio(uint gpio)
         // make a sm config
         conf[gpio] = button_debounce_program_get_default_config(offset[gpio]);
         // set the initial clkdiv to 10ms
-        sm_config_set_clkdiv(&conf[gpio], 10.);
+        nominal_clkdiv[gpio] = 10.;
+        sm_config_set_clkdiv(&conf[gpio], scale_clkdiv(nominal_clkdiv[gpio]));
         if (pio_debounced[gpio] == pio0)
             pio0_already_set = gpio;
         else
@@ -188,8 +191,9 @@ int Debounce::set_debounce_time(uint gpio, float debounce_time)
         clkdiv = 1.0;
     else if (clkdiv > 65535.)
         clkdiv = 65535.;
-    // set the clkdiv for both pio
-    sm_config_set_clkdiv(&conf[gpio], clkdiv);
+    // set the clkdiv for both pio (scaled to the current system clock)
+    nominal_clkdiv[gpio] = clkdiv;
+    sm_config_set_clkdiv(&conf[gpio], scale_clkdiv(clkdiv));
     // do the init of the pio/sm
     pio_sm_init(pio_debounced[gpio], sm_debounced[gpio], offset[gpio], &conf[gpio]);
     // enable the sm
@@ -197,12 +201,42 @@ int Debounce::set_debounce_time(uint gpio, float debounce_time)
     return 0;
 };
 
+/* 
+ * recomputes the clock dividers of all debounced gpios after the system clock was changed
+ */
+int Debounce::update_clock()
+{
+    for (int gpio = 0; gpio < 32; gpio++)
+    {
+        if (gpio_debounced[gpio] == UNUSED)
+            continue;
+        // keep the configuration in sync for a later set_debounce_time()
+        sm_config_set_clkdiv(&conf[gpio], scale_clkdiv(nominal_clkdiv[gpio]));
+        pio_sm_set_clkdiv(pio_debounced[gpio], sm_debounced[gpio], scale_clkdiv(nominal_clkdiv[gpio]));
+    }
+    return 0;
+}
+
+/* 
+ * scales a clock divider given for 125 MHz to the current system clock
+ * @param clkdiv: clock divider at 125 MHz
+ */
+float Debounce::scale_clkdiv(float clkdiv)
+{
+    float scaled = clkdiv * (clock_get_hz(clk_sys) / 125000000.f);
+    if (scaled < 1.0)
+        scaled = 1.0;
+    else if (scaled > 65535.)
+        scaled = 65535.;
+    return scaled;
+}
+
 /* 
  * Read the current value of the debounced the gpio
  * @param gpio: the gpio whose value (low, high) is read
  *              the gpio must have previously been debounced using debounce_gpio()
  */
-int Debounce::read(uint gpio)
+int __not_in_flash_func(Debounce::read)(uint gpio)
 {
     // check if the gpio is valid
     if ((gpio > 28) || gpio == 23 || gpio == 24 || gpio == 25)
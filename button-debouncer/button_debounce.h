@@ -51,7 +51,19 @@ public:
      */
     int undebounce_gpio(uint gpio);
 
+    /* 
+     * recomputes the clock dividers of all debounced gpios after the system clock was changed,
+     * the state machines keep running and keep their debounced level
+     */
+    int update_clock();
+
 private:
+    /* 
+     * scales a clock divider given for 125 MHz to the current system clock
+     * @param clkdiv: clock divider at 125 MHz
+     */
+    float scale_clkdiv(float clkdiv);
+
     // the number of instantiated buttons to debounce
     uint num_of_debounced = 0;
 
@@ -66,6 +78,8 @@ private:
     int offset[32];
     // for each gpio the configurations of the pio sm
     pio_sm_config conf[32];
+    // for each gpio the clock divider at 125 MHz system clock
+    float nominal_clkdiv[32];
     // flags to indicate the pio has already been set (and by which gpio)
     int pio0_already_set, pio1_already_set;
 };
@@ -0,0 +1,356 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * host micro-benchmarks of the CWGenerator and the WinKeyerParser
+ * The results are printed as one JSON object per line:
+ * {"benchmark": "<name>", "unit": "ns/<op>", "value": <ns per op>, "iterations": <n>}
+ * The rendering backends are reported in samples per second on one core:
+ * {"benchmark": "render_tone_<backend>", "unit": "samples/s", "value": <samples per s>, "iterations": <n>}
+ * Before, all backends are checked against the scalar reference: {"check": "render_tone_<backend>", "identical": <bool>}
+ * The statically allocated CWGeneratorFixed is checked against CWGenerator and benchmarked with the suffix "_fixed"
+ * The pile-up trainer is benchmarked with one and with TRAINER_MAX_STATIONS keyed stations: "trainer_<stations>"
+ *
+ * usage: cw_bench [iterations]
+ */
+
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#include "cw_generator.h"
+#include "host_platform.h"
+#include "host_render_simd.h"
+#include "trainer.h"
+#include "winkeyer_parser.h"
+
+typedef std::chrono::steady_clock bench_clock;
+
+// canned WinKeyer stream: speed change and text
+static const uint8_t WK_BENCH_STREAM[] = {
+    0x02, 25,
+    'c', 'q', ' ', 'c', 'q', ' ', 'd', 'e', ' ', 'd', 'g', '1', 'p', 's', 'i', ' ', 'k'
+};
+
+static volatile int64_t bench_sink;         // keeps the results alive
+
+static double elapsed_ns(bench_clock::time_point start, bench_clock::time_point end) {
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+static void print_result(const char *name, const char *unit, double ns, uint64_t ops) {
+    printf("{\"benchmark\": \"%s\", \"unit\": \"ns/%s\", \"value\": %.3f, \"iterations\": %llu}\n",
+           name, unit, ns / ops, (unsigned long long)ops);
+}
+
+typedef CWGeneratorFixed<HOST_SAMPLE_RATE, HOST_SAMPLE_BUFFER_SIZE> HostCWGenerator;
+
+/*
+ * renders the same packet repeatedly
+ */
+template <typename GENERATOR>
+static void bench_render(const char *name, GENERATOR *cwgen, uint64_t iterations) {
+    int64_t sum = 0;
+
+    bench_clock::time_point start = bench_clock::now();
+    for (uint64_t i = 0; i < iterations; i++) {
+        int16_t *buffer = (int16_t *)cwgen->get_audio_buffer();
+        sum += buffer[i % HOST_SAMPLE_BUFFER_SIZE];
+    }
+    bench_clock::time_point end = bench_clock::now();
+
+    bench_sink = sum;
+    print_result(name, "packet", elapsed_ns(start, end), iterations);
+}
+
+/*
+ * renders a pile-up with all stations keyed into packets of silence
+ */
+static void bench_trainer(uint32_t stations, uint64_t iterations) {
+    int16_t samples[HOST_SAMPLE_BUFFER_SIZE];
+    char name[32];
+    int64_t sum = 0;
+
+    trainer_start(stations, 1, HOST_SAMPLE_RATE);
+    trainer_key_all();
+    bench_clock::time_point start = bench_clock::now();
+    for (uint64_t i = 0; i < iterations; i++) {
+        memset(samples, 0, sizeof(samples));
+        trainer_render(samples, HOST_SAMPLE_BUFFER_SIZE);
+        sum += samples[i % HOST_SAMPLE_BUFFER_SIZE];
+    }
+    bench_clock::time_point end = bench_clock::now();
+    trainer_stop();
+
+    bench_sink = sum;
+    snprintf(name, sizeof(name), "trainer_%u", (unsigned)stations);
+    print_result(name, "packet", elapsed_ns(start, end), iterations);
+}
+
+// tone and envelope tables built like CWGenerator::init_buffers()
+typedef struct {
+    std::vector<float> signal;
+    std::vector<float> keyshape;
+    cw_tone_params_t params;
+} tone_tables_t;
+
+static void init_tone(tone_tables_t *tone, uint16_t freq, uint16_t wpm, float risetime, uint16_t volume) {
+    uint32_t maxsize = ceil(RISETIME_MAX * HOST_SAMPLE_RATE / 1000);
+    uint32_t period = ceil(HOST_SAMPLE_RATE / (float)(freq));
+    uint32_t dit = (60 / (50 * (float)(wpm))) * HOST_SAMPLE_RATE;
+    dit = ceil((float)(dit) / period) * period;
+    uint32_t rise = ceil(risetime * HOST_SAMPLE_RATE / 1000);
+    rise = rise > dit / 2 ? dit / 2 : rise;
+
+    tone->signal.resize(period);
+    for (uint32_t i = 0; i < period; i++) {
+        tone->signal[i] = volume * sin(i * 2.0 * M_PI * 1 / (float)(period));
+    }
+    tone->keyshape.resize(maxsize);
+    for (uint32_t i = 0; i < maxsize; i++) {
+        tone->keyshape[i] = 0.35875-0.48829*cos(M_PI * i / maxsize) + 0.14128*cos(2 * M_PI * i / maxsize) - 0.01168*cos(4 * M_PI * i / maxsize);
+    }
+    tone->params = {tone->signal.data(), period, tone->keyshape.data(), maxsize, (uint32_t)ceil(maxsize / rise), 0, DAH_UNITS * dit};
+}
+
+/*
+ * renders DAH elements for frequencies, speeds, rise times and packet offsets with a backend and compares
+ * the samples with the scalar reference
+ * @return true if all samples are identical
+ */
+static bool check_render_backend(host_render_backend_t backend, uint64_t *packets) {
+    int16_t reference[HOST_SAMPLE_BUFFER_SIZE + 16];
+    int16_t samples[HOST_SAMPLE_BUFFER_SIZE + 16];
+    tone_tables_t tone;
+
+    for (uint16_t freq = CWGenerator::audio_minfreq; freq <= CWGenerator::audio_maxfreq; freq += 25) {
+        for (uint16_t wpm = WPM_MIN; wpm <= WPM_MAX; wpm += 22) {
+            for (float risetime = RISETIME_MIN; risetime <= RISETIME_MAX; risetime *= 3) {
+                init_tone(&tone, freq, wpm, risetime, MAX_VOLUME);
+                for (uint32_t count = HOST_SAMPLE_BUFFER_SIZE - 1; count <= HOST_SAMPLE_BUFFER_SIZE + 16; count += 17) {
+                    for (uint32_t start = 0; start < tone.params.end + count; start += count - 3) {
+                        tone.params.start = start;
+                        memset(reference, 0, sizeof(reference));
+                        memset(samples, 0, sizeof(samples));
+                        cw_render_tone(&tone.params, reference, count);
+                        host_render_tone_backend(backend, &tone.params, samples, count);
+                        if (memcmp(reference, samples, sizeof(samples)) != 0) {
+                            return false;
+                        }
+                        (*packets)++;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ * sends the same characters through CWGenerator and CWGeneratorFixed and compares all packets, including
+ * the packet level rendering of cw_render_tone_fixed against cw_render_tone
+ * @return true if all samples are identical
+ */
+static bool check_fixed_generator(uint64_t *packets) {
+    CWGenerator *reference = new CWGenerator(HOST_SAMPLE_RATE, HOST_SAMPLE_BUFFER_SIZE);
+    HostCWGenerator *fixed = new HostCWGenerator();
+    char morse[] = "-.-. --.- ";
+    bool identical = true;
+
+    for (uint16_t freq = CWGenerator::audio_minfreq; identical && freq <= CWGenerator::audio_maxfreq; freq += 75) {
+        for (uint16_t wpm = WPM_MIN; identical && wpm <= WPM_MAX; wpm += 22) {
+            reference->reset();
+            fixed->reset();
+            reference->set_frequency(freq);
+            fixed->set_frequency(freq);
+            reference->set_wpm(wpm);
+            fixed->set_wpm(wpm);
+            reference->send_character(morse);
+            fixed->send_character(morse);
+
+            for (uint32_t i = 0; identical && (i == 0 || reference->is_busy()); i++) {
+                identical = memcmp(reference->get_audio_buffer(), fixed->get_audio_buffer(), reference->get_audio_buffer_size()) == 0 &&
+                            reference->get_audio_buffer_size() == fixed->get_audio_buffer_size();
+                reference->update_statemachine();
+                fixed->update_statemachine();
+                (*packets)++;
+            }
+        }
+    }
+
+    int16_t expected[HOST_SAMPLE_BUFFER_SIZE];
+    int16_t samples[HOST_SAMPLE_BUFFER_SIZE];
+    tone_tables_t tone;
+    for (uint16_t freq = CWGenerator::audio_minfreq; identical && freq <= CWGenerator::audio_maxfreq; freq += 25) {
+        init_tone(&tone, freq, WPM_MAX, RISETIME_MIN, MAX_VOLUME);
+        for (uint32_t start = 0; identical && start < tone.params.end + HOST_SAMPLE_BUFFER_SIZE; start += 7) {
+            tone.params.start = start;
+            memset(expected, 0, sizeof(expected));
+            memset(samples, 0, sizeof(samples));
+            cw_render_tone(&tone.params, expected, HOST_SAMPLE_BUFFER_SIZE);
+            cw_render_tone_fixed<HOST_SAMPLE_BUFFER_SIZE>(&tone.params, samples);
+            identical = memcmp(expected, samples, sizeof(samples)) == 0;
+            (*packets)++;
+        }
+    }
+
+    delete fixed;
+    delete reference;
+    return identical;
+}
+
+/*
+ * renders a long DAH repeatedly in packets of the given size and reports the samples per second
+ */
+static void bench_render_backend(host_render_backend_t backend, uint32_t packet_size, uint64_t iterations) {
+    std::vector<int16_t> samples(packet_size);
+    tone_tables_t tone;
+    int64_t sum = 0;
+    uint64_t rendered = 0;
+
+    init_tone(&tone, DEFAULT_FREQUENCY, WPM_MIN, DEFAULT_RISETIME, MAX_VOLUME);
+    bench_clock::time_point start = bench_clock::now();
+    for (uint64_t i = 0; i < iterations; i++) {
+        for (tone.params.start = 0; tone.params.start < tone.params.end; tone.params.start += packet_size) {
+            host_render_tone_backend(backend, &tone.params, samples.data(), packet_size);
+            sum += samples[i % packet_size];
+            rendered += packet_size;
+        }
+    }
+    double ns = elapsed_ns(start, bench_clock::now());
+
+    bench_sink = sum;
+    printf("{\"benchmark\": \"render_tone_%s_%u\", \"unit\": \"samples/s\", \"value\": %.0f, \"iterations\": %llu}\n",
+           host_render_backend_name(backend), packet_size, rendered / ns * 1e9, (unsigned long long)rendered);
+}
+
+int main(int argc, char **argv) {
+    uint64_t iterations = argc > 1 ? strtoull(argv[1], NULL, 10) : 200000;
+    char morse[] = ".-.-.";
+
+    CWGenerator *cwgen = new CWGenerator(HOST_SAMPLE_RATE, HOST_SAMPLE_BUFFER_SIZE);
+    WinKeyerParser *parser = new WinKeyerParser(cwgen);
+
+    // packet rendering: silence, rising edge of a DAH and sustained tone
+    cwgen->reset();
+    bench_render("render_silence", cwgen, iterations);
+
+    cwgen->send_character(CWGenerator::CHAR_DAH);
+    cwgen->update_statemachine();
+    bench_render("render_edge", cwgen, iterations);
+
+    for (uint32_t i = 0; i < (uint32_t)cwgen->get_risetime() + 2; i++) {         // one packet per ms
+        cwgen->update_statemachine();
+    }
+    bench_render("render_sustain", cwgen, iterations);
+
+    // state machine steps through a stream of characters
+    double ns = 0;
+    for (uint64_t i = 0; i < iterations; i += 1000) {
+        cwgen->reset();
+        cwgen->send_character(morse);
+
+        bench_clock::time_point start = bench_clock::now();
+        for (int j = 0; j < 1000; j++) {
+            cwgen->update_statemachine();
+        }
+        ns += elapsed_ns(start, bench_clock::now());
+    }
+    print_result("update_statemachine", "step", ns, (iterations + 999) / 1000 * 1000);
+
+    // full packet cycle as done by the USB callbacks: render followed by a state machine step
+    ns = 0;
+    int64_t sum = 0;
+    for (uint64_t i = 0; i < iterations; i += 1000) {
+        cwgen->reset();
+        cwgen->send_character(morse);
+
+        bench_clock::time_point start = bench_clock::now();
+        for (int j = 0; j < 1000; j++) {
+            sum += ((int16_t *)cwgen->get_audio_buffer())[j % HOST_SAMPLE_BUFFER_SIZE];
+            cwgen->update_statemachine();
+        }
+        ns += elapsed_ns(start, bench_clock::now());
+    }
+    bench_sink = sum;
+    print_result("packet_cycle", "packet", ns, (iterations + 999) / 1000 * 1000);
+
+    // parser
+    uint8_t buffer[sizeof(WK_BENCH_STREAM)];
+    uint64_t parse_iterations = iterations / 10 + 1;
+    ns = 0;
+    for (uint64_t i = 0; i < parse_iterations; i++) {
+        cwgen->reset();
+        memcpy(buffer, WK_BENCH_STREAM, sizeof(buffer));
+
+        bench_clock::time_point start = bench_clock::now();
+        parser->parse_message(buffer, sizeof(buffer), sizeof(buffer));
+        ns += elapsed_ns(start, bench_clock::now());
+    }
+    print_result("parse_message", "byte", ns, parse_iterations * sizeof(WK_BENCH_STREAM));
+
+    // tone rendering backends
+    bool identical = true;
+    for (int b = HOST_RENDER_SCALAR; b < HOST_RENDER_BACKENDS; b++) {
+        host_render_backend_t backend = (host_render_backend_t)b;
+        if (!host_render_supported(backend)) {
+            continue;
+        }
+        uint64_t packets = 0;
+        bool ok = check_render_backend(backend, &packets);
+        printf("{\"check\": \"render_tone_%s\", \"identical\": %s, \"packets\": %llu}\n", host_render_backend_name(backend),
+               ok ? "true" : "false", (unsigned long long)packets);
+        identical = identical && ok;
+    }
+    for (int b = HOST_RENDER_SCALAR; b < HOST_RENDER_BACKENDS; b++) {
+        if (host_render_supported((host_render_backend_t)b)) {
+            bench_render_backend((host_render_backend_t)b, HOST_SAMPLE_BUFFER_SIZE, iterations / 200 + 1);
+            bench_render_backend((host_render_backend_t)b, 4800, iterations / 200 + 1);
+        }
+    }
+
+    // statically allocated generator for the fixed USB audio format
+    uint64_t packets = 0;
+    bool ok = check_fixed_generator(&packets);
+    printf("{\"check\": \"cwgen_fixed\", \"identical\": %s, \"packets\": %llu}\n", ok ? "true" : "false",
+           (unsigned long long)packets);
+    identical = identical && ok;
+
+    static HostCWGenerator cwgen_fixed;
+    cwgen_fixed.send_character(CWGenerator::CHAR_DAH);
+    cwgen_fixed.update_statemachine();
+    for (uint32_t i = 0; i < (uint32_t)cwgen_fixed.get_risetime() + 2; i++) {
+        cwgen_fixed.update_statemachine();
+    }
+    bench_render("render_sustain_fixed", &cwgen_fixed, iterations);
+
+    // pile-up trainer
+    bench_trainer(1, iterations);
+    bench_trainer(TRAINER_MAX_STATIONS, iterations);
+
+    delete parser;
+    delete cwgen;
+    return identical ? 0 : 1;
+}
@@ -0,0 +1,58 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * recording stand-in for the CWGenerator. Tools linking cwgen_recorder.cpp instead of cw_generator.cpp
+ * get a CWGenerator that stores every call made by the WinKeyerParser in a list of events
+ */
+
+#ifndef _CWGEN_RECORDER_H_
+#define _CWGEN_RECORDER_H_
+
+#include <vector>
+
+#include "cw_generator.h"
+
+typedef enum {
+    EVENT_CHARACTER,                        // send_character(char *), str is the morse string
+    EVENT_WPM,                              // set_wpm()
+    EVENT_FREQUENCY,                        // set_frequency()
+    EVENT_RISETIME,                         // set_risetime()
+    EVENT_VOLUME,                           // set_volume()
+    EVENT_REPLY                             // byte returned to the host (added by the tools)
+} cwgen_event_type_t;
+
+typedef struct {
+    cwgen_event_type_t type;
+    uint32_t value;
+    const char *str;
+} cwgen_event_t;
+
+/*
+ * returns the list of recorded events. The tools may clear it or append their own events
+ */
+std::vector<cwgen_event_t> &cwgen_recorder_events();
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * controls of the host platform emulation used by the host tools and benchmarks
+ */
+
+#ifndef _HOST_PLATFORM_H_
+#define _HOST_PLATFORM_H_
+
+#include "pico/types.h"
+
+#define HOST_SAMPLE_RATE 48000              // sample rate of the USB microphone (see tusb_config.h)
+#define HOST_SAMPLE_BUFFER_SIZE 48          // samples per USB packet (see usb_devices.h)
+
+typedef void (*host_queue_block_handler_t)(void);
+
+/*
+ * sets the simulated time
+ * @param us: time in us since boot
+ */
+void host_set_time_us(uint64_t us);
+
+/*
+ * advances the simulated time
+ * @param us: time in us
+ */
+void host_advance_time_us(uint64_t us);
+
+/*
+ * sets the input level of a GPIO and invokes the GPIO interrupt callback on enabled edges
+ * @param gpio: GPIO number
+ * @param level: new input level
+ */
+void host_gpio_set(uint gpio, bool level);
+
+/*
+ * sets the time a GPIO level has to be stable before host_gpio_get_settled() reports it. Used to emulate
+ * the PIO button debouncer
+ * @param gpio: GPIO number
+ * @param us: settle time in us
+ */
+void host_gpio_set_settle_time(uint gpio, uint32_t us);
+
+/*
+ * returns the last level of a GPIO that was stable for at least the settle time (debounced level)
+ * @param gpio: GPIO number
+ * @return debounced level
+ */
+bool host_gpio_get_settled(uint gpio);
+
+/*
+ * returns the number of DMA transfers triggered since the start of the program
+ */
+uint32_t host_dma_transfer_count();
+
+/*
+ * sets the handler called by queue_add_blocking() while the queue is full. The handler has to
+ * consume elements (e.g. by rendering audio), otherwise the program is aborted
+ * @param handler: handler or NULL
+ */
+void host_set_queue_block_handler(host_queue_block_handler_t handler);
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * helpers used by the host tools to drive the CWGenerator the same way the USB callbacks do and to
+ * write the rendered audio to WAV files
+ */
+
+#ifndef _HOST_RENDER_H_
+#define _HOST_RENDER_H_
+
+#include <stdio.h>
+
+#include "cw_generator.h"
+#include "host_platform.h"
+
+/*
+ * renders the next packet like the USB microphone callbacks: the audio buffer is fetched (tx pre load),
+ * the state machine is updated (tx post load) and the simulated time advances by one packet
+ * @param cwgen: generator to render
+ * @param samples: buffer receiving HOST_SAMPLE_BUFFER_SIZE samples
+ */
+void host_render_packet(CWGenerator *cwgen, int16_t *samples);
+
+// WAV file written by the host tools (16 bit mono PCM)
+typedef struct {
+    FILE *file;
+    uint32_t sample_rate;
+    uint32_t data_size;                     // number of data bytes written so far
+} wav_file_t;
+
+/*
+ * creates a WAV file. The sizes in the header are updated by wav_close()
+ * @param wav: WAV file to initialize
+ * @param path: file name
+ * @param sample_rate: sample rate in Hz
+ * @return true on success
+ */
+bool wav_open(wav_file_t *wav, const char *path, uint32_t sample_rate);
+
+/*
+ * appends samples to a WAV file
+ * @param wav: WAV file opened with wav_open()
+ * @param samples: samples to write
+ * @param count: number of samples
+ * @return true on success
+ */
+bool wav_write(wav_file_t *wav, const int16_t *samples, uint32_t count);
+
+/*
+ * updates the header and closes a WAV file
+ * @param wav: WAV file opened with wav_open()
+ * @return true on success
+ */
+bool wav_close(wav_file_t *wav);
+
+#endif
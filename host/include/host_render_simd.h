@@ -0,0 +1,78 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * vectorized host backends of cw_render_tone() (SSE2, AVX2) with runtime dispatch. The host build renders
+ * all packets of the CWGenerator through host_render_tone() which calls the selected backend. All backends
+ * produce the same samples as the scalar reference.
+ */
+
+#ifndef _HOST_RENDER_SIMD_H_
+#define _HOST_RENDER_SIMD_H_
+
+#include "cw_generator.h"
+
+typedef enum {
+    HOST_RENDER_SCALAR,                     // cw_render_tone() of the firmware
+    HOST_RENDER_SSE2,
+    HOST_RENDER_AVX2,
+    HOST_RENDER_BACKENDS
+} host_render_backend_t;
+
+/*
+ * renders the tone with the selected backend (see cw_render_tone())
+ */
+void host_render_tone(const cw_tone_params_t *params, int16_t *out, uint32_t count);
+
+/*
+ * renders the tone with the given backend. The backend must be supported by the CPU
+ */
+void host_render_tone_backend(host_render_backend_t backend, const cw_tone_params_t *params, int16_t *out, uint32_t count);
+
+/*
+ * checks if a backend is supported by the CPU
+ * @param backend: backend
+ * @return true if supported
+ */
+bool host_render_supported(host_render_backend_t backend);
+
+/*
+ * selects the backend used by host_render_tone(). The fastest supported backend is selected by default
+ * @param backend: backend
+ * @return false if the backend is not supported by the CPU
+ */
+bool host_render_set_backend(host_render_backend_t backend);
+
+/*
+ * returns the backend used by host_render_tone()
+ */
+host_render_backend_t host_render_get_backend();
+
+/*
+ * returns the name of a backend ("scalar", "sse2", "avx2")
+ */
+const char *host_render_backend_name(host_render_backend_t backend);
+
+#endif
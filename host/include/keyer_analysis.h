@@ -0,0 +1,63 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * helpers to recover the keyed elements and gaps from rendered audio
+ */
+
+#ifndef _KEYER_ANALYSIS_H_
+#define _KEYER_ANALYSIS_H_
+
+#include <string>
+#include <vector>
+
+#include "pico/types.h"
+
+// tone or gap between two tones recovered from the audio
+typedef struct {
+    bool tone;                              // true: element, false: gap
+    uint32_t start;                         // index of the first sample
+    uint32_t length;                        // number of samples
+} keyer_segment_t;
+
+/*
+ * splits the samples into tones and gaps. Zero samples within a tone (zero crossings) are bridged
+ * if the run of zeros is not longer than merge_gap. Leading and trailing silence is not returned
+ * @param samples: rendered audio
+ * @param merge_gap: maximum number of zero samples within a tone (e.g. two periods of the tone)
+ * @return list of alternating tone and gap segments, starting and ending with a tone
+ */
+std::vector<keyer_segment_t> keyer_detect_segments(const std::vector<int16_t> &samples, uint32_t merge_gap);
+
+/*
+ * converts the segments into morse notation: '.' and '-' for elements, ' ' between characters and
+ * " / " between words. Tones shorter than 2 units are DITs, gaps of 2 to 5 units separate characters
+ * @param segments: segments returned by keyer_detect_segments()
+ * @param unit: length of a time unit (DIT) in samples
+ * @return morse notation
+ */
+std::string keyer_segments_to_morse(const std::vector<keyer_segment_t> &segments, double unit);
+
+#endif
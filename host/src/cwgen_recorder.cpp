@@ -0,0 +1,125 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * recording stand-in for the CWGenerator
+ */
+
+#include "cwgen_recorder.h"
+
+static std::vector<cwgen_event_t> events;
+
+std::vector<cwgen_event_t> &cwgen_recorder_events() {
+    return events;
+}
+
+static void record(cwgen_event_type_t type, uint32_t value, const char *str) {
+    cwgen_event_t event = {type, value, str};
+    events.push_back(event);
+}
+
+CWGenerator::CWGenerator(uint32_t sample_rate, uint32_t sample_buffer_size) : CWGenerator(sample_rate, sample_buffer_size, DEFAULT_FREQUENCY, DEFAULT_WPM, DEFAULT_VOLUME, DEFAULT_RISETIME) {}
+
+CWGenerator::CWGenerator(uint32_t sample_rate, uint32_t sample_buffer_size, uint16_t freq, uint16_t wpm, uint16_t volume, float risetime) {
+    cw_sample_rate = sample_rate;
+    cw_sample_buffer_size = sample_buffer_size;
+    cw_frequency = freq;
+    cw_wpm = wpm;
+    cw_volume = volume;
+    cw_risetime = risetime;
+    curstate = STATE_IDLE;
+}
+
+CWGenerator::~CWGenerator() {
+}
+
+void CWGenerator::set_frequency(uint16_t freq) {
+    cw_frequency = freq;
+    record(EVENT_FREQUENCY, freq, NULL);
+}
+
+uint16_t CWGenerator::get_frequency() {
+    return cw_frequency;
+}
+
+void CWGenerator::set_wpm(uint16_t wpm) {
+    cw_wpm = wpm;
+    record(EVENT_WPM, wpm, NULL);
+}
+
+uint16_t CWGenerator::get_wpm() {
+    return cw_wpm;
+}
+
+void CWGenerator::set_risetime(float risetime) {
+    cw_risetime = risetime;
+    record(EVENT_RISETIME, (uint32_t)risetime, NULL);
+}
+
+float CWGenerator::get_risetime() {
+    return cw_risetime;
+}
+
+void CWGenerator::set_volume(uint16_t vol) {
+    cw_volume = vol;
+    record(EVENT_VOLUME, vol, NULL);
+}
+
+uint16_t CWGenerator::get_volume() {
+    return cw_volume;
+}
+
+void CWGenerator::send_character(CW_CHARACTERS ch) {
+    (void)ch;
+}
+
+void CWGenerator::send_character(char *ch) {
+    record(EVENT_CHARACTER, 0, ch);
+}
+
+void CWGenerator::update_statemachine() {
+}
+
+void CWGenerator::reset() {
+}
+
+void CWGenerator::set_paddles(bool enabled) {
+    paddles_enabled = enabled;
+}
+
+bool CWGenerator::is_busy() {
+    return false;
+}
+
+void *CWGenerator::get_audio_buffer() {
+    return NULL;
+}
+
+uint32_t CWGenerator::get_audio_buffer_size() {
+    return 0;
+}
+
+void CWGenerator::update_timing() {
+}
@@ -0,0 +1,102 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * host stand-in for the PIO button debouncer. Like the PIO program, a new input level set with host_gpio_set()
+ * is reported by read() once it was stable for the debounce time
+ */
+
+#include "../../button-debouncer/button_debounce.h"
+#include "host_platform.h"
+
+#define UNUSED -10
+
+/*
+ * time a level has to be stable until the PIO program switches over: 31 loops of two instructions
+ * at 125 MHz / clkdiv (see button_debounce.cpp)
+ * @param clkdiv: clock divider of the state machine
+ * @return debounce time in us
+ */
+static uint32_t debounce_us(float clkdiv) {
+    return (uint32_t)(clkdiv * 62 / 125);
+}
+
+Debounce::Debounce(void) {
+    for (int i = 0; i < 32; i++) {
+        gpio_debounced[i] = UNUSED;
+        pio_debounced[i] = (PIO)NULL;
+        sm_debounced[i] = UNUSED;
+        offset[i] = UNUSED;
+    }
+    num_of_debounced = 0;
+    pio0_already_set = UNUSED;
+    pio1_already_set = UNUSED;
+}
+
+int Debounce::debounce_gpio(uint gpio) {
+    if ((gpio > 28) || (gpio_debounced[gpio] != UNUSED)) {
+        return -1;
+    }
+
+    gpio_debounced[gpio] = gpio;
+    num_of_debounced++;
+    host_gpio_set_settle_time(gpio, debounce_us(10.));      // initial clkdiv of the PIO program
+    return 0;
+}
+
+int Debounce::set_debounce_time(uint gpio, float debounce_time) {
+    if ((gpio > 28) || (debounce_time < 0.5) || (debounce_time > 30)) {
+        return -1;
+    }
+
+    float clkdiv = 2. * debounce_time * 1000.;
+    host_gpio_set_settle_time(gpio, debounce_us(clkdiv < 65535. ? clkdiv : 65535.));
+    return 0;
+}
+
+int Debounce::update_clock() {
+    return 0;                               // the host clock does not change
+}
+
+float Debounce::scale_clkdiv(float clkdiv) {
+    return clkdiv;
+}
+
+int Debounce::read(uint gpio) {
+    if ((gpio > 28) || (gpio_debounced[gpio] == UNUSED)) {
+        return -1;
+    }
+    return host_gpio_get_settled(gpio) ? 1 : 0;
+}
+
+int Debounce::undebounce_gpio(uint gpio) {
+    if ((gpio > 28) || (gpio_debounced[gpio] == UNUSED)) {
+        return -1;
+    }
+
+    gpio_debounced[gpio] = UNUSED;
+    num_of_debounced--;
+    return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * host stand-ins for the diagnostics that depend on the RP2040 hardware (PC profiler, stack painting, clock
+ * scaling). The SysTick based self-benchmark is reached through a parser handler and not linked on the host,
+ * the benchmarks in host/bench are used instead
+ */
+
+#include "mem_stats.h"
+#include "pc_profiler.h"
+#include "power_manager.h"
+
+static uint32_t not_available(char *buf, uint32_t maxsize) {
+    uint32_t len = snprintf(buf, maxsize, "not available on host\n");
+    return len < maxsize ? len : maxsize - 1;
+}
+
+void mem_stats_init() {
+}
+
+void mem_stats_account(const char *subsystem, uint32_t bytes) {
+    (void)subsystem;
+    (void)bytes;
+}
+
+uint32_t mem_stats_report(char *buf, uint32_t maxsize) {
+    return not_available(buf, maxsize);
+}
+
+void pc_profiler_init_core() {
+}
+
+void pc_profiler_start(uint32_t rate) {
+    (void)rate;
+}
+
+void pc_profiler_stop() {
+}
+
+void pc_profiler_clear() {
+}
+
+uint32_t pc_profiler_dump(uint32_t page, char *buf, uint32_t maxsize) {
+    (void)page;
+    return not_available(buf, maxsize);
+}
+
+void power_manager_activity() {
+}
+
+void power_manager_tone_sent() {
+}
+
+void power_manager_reset() {
+}
+
+uint32_t power_manager_report(char *buf, uint32_t maxsize) {
+    return not_available(buf, maxsize);
+}
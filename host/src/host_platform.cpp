@@ -0,0 +1,374 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * host emulation of the pico-sdk functions used by the CWGenerator and the WinKeyerParser
+ */
+
+#include <cstring>
+
+#include "host_platform.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/pio.h"
+#include "pico/bootrom.h"
+#include "pico/stdlib.h"
+#include "pico/util/queue.h"
+
+static uint64_t host_time = 0;                          // simulated time in us
+static bool gpio_level[NUM_BANK0_GPIOS];                // input level of each GPIO
+static uint32_t gpio_irq_events[NUM_BANK0_GPIOS];       // enabled interrupt events of each GPIO
+static uint64_t gpio_change_time[NUM_BANK0_GPIOS];      // time [us] of the last level change of each GPIO
+static bool gpio_settled[NUM_BANK0_GPIOS];              // level that was stable for at least the settle time
+static uint32_t gpio_settle_time[NUM_BANK0_GPIOS];      // settle time [us] of the debouncer emulation
+static gpio_irq_callback_t gpio_irq_callback = NULL;
+static host_queue_block_handler_t queue_block_handler = NULL;
+
+// DMA channel emulation
+typedef struct {
+    bool claimed;
+    dma_channel_config config;
+    volatile void *write_addr;
+    const volatile void *read_addr;
+    uint transfer_count;
+} host_dma_channel_t;
+
+static host_dma_channel_t dma_channels[NUM_DMA_CHANNELS];
+static uint32_t dma_transfers = 0;                      // number of triggered DMA transfers
+
+pio_hw_t host_pio_hw[2];
+
+/*
+ * simulated time
+ */
+void host_set_time_us(uint64_t us) {
+    host_time = us;
+}
+
+void host_advance_time_us(uint64_t us) {
+    host_time += us;
+}
+
+uint32_t time_us_32() {
+    return (uint32_t)host_time;
+}
+
+uint64_t time_us_64() {
+    return host_time;
+}
+
+void sleep_us(uint64_t us) {
+    host_time += us;
+}
+
+void sleep_ms(uint32_t ms) {
+    host_time += (uint64_t)ms * 1000;
+}
+
+bool stdio_init_all() {
+    return true;
+}
+
+uint32_t clock_get_hz(enum clock_index clk_index) {
+    return clk_index == clk_sys ? 125000000 : 12000000;
+}
+
+void reset_usb_boot(uint32_t usb_activity_gpio_pin_mask, uint32_t disable_interface_mask) {
+    (void)usb_activity_gpio_pin_mask;
+    (void)disable_interface_mask;
+    printf("reset_usb_boot: ignored on host\n");
+}
+
+/*
+ * GPIO
+ */
+void host_gpio_set(uint gpio, bool level) {
+    if (gpio >= NUM_BANK0_GPIOS) {
+        return;
+    }
+
+    bool old_level = gpio_level[gpio];
+    if (host_time - gpio_change_time[gpio] >= gpio_settle_time[gpio]) {
+        gpio_settled[gpio] = old_level;             // previous level was stable long enough to pass the debouncer
+    }
+    if (level != old_level) {
+        gpio_change_time[gpio] = host_time;
+    }
+    gpio_level[gpio] = level;
+
+    uint32_t events = 0;
+    if (old_level && !level) {
+        events = GPIO_IRQ_EDGE_FALL;
+    } else if (!old_level && level) {
+        events = GPIO_IRQ_EDGE_RISE;
+    }
+    if ((events & gpio_irq_events[gpio]) && gpio_irq_callback) {
+        gpio_irq_callback(gpio, events & gpio_irq_events[gpio]);
+    }
+}
+
+void host_gpio_set_settle_time(uint gpio, uint32_t us) {
+    if (gpio < NUM_BANK0_GPIOS) {
+        gpio_settle_time[gpio] = us;
+    }
+}
+
+bool host_gpio_get_settled(uint gpio) {
+    if (gpio >= NUM_BANK0_GPIOS) {
+        return false;
+    }
+    if (host_time - gpio_change_time[gpio] >= gpio_settle_time[gpio]) {
+        return gpio_level[gpio];
+    }
+    return gpio_settled[gpio];
+}
+
+void gpio_init(uint gpio) {
+    (void)gpio;
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+    (void)gpio;
+    (void)out;
+}
+
+void gpio_pull_up(uint gpio) {
+    if (gpio < NUM_BANK0_GPIOS) {
+        gpio_level[gpio] = true;
+        gpio_settled[gpio] = true;
+    }
+}
+
+void gpio_put(uint gpio, bool value) {
+    if (gpio < NUM_BANK0_GPIOS) {
+        gpio_level[gpio] = value;
+        gpio_settled[gpio] = value;
+    }
+}
+
+bool gpio_get(uint gpio) {
+    return gpio < NUM_BANK0_GPIOS ? gpio_level[gpio] : false;
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled) {
+    if (gpio >= NUM_BANK0_GPIOS) {
+        return;
+    }
+
+    if (enabled) {
+        gpio_irq_events[gpio] |= events;
+    } else {
+        gpio_irq_events[gpio] &= ~events;
+    }
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t events, bool enabled, gpio_irq_callback_t callback) {
+    gpio_set_irq_enabled(gpio, events, enabled);
+    gpio_irq_callback = callback;
+}
+
+/*
+ * PIO
+ */
+int pio_claim_unused_sm(PIO pio, bool required) {
+    for (int sm = 0; sm < 4; sm++) {
+        if (!(pio->sm_claimed & (1u << sm))) {
+            pio->sm_claimed |= 1u << sm;
+            return sm;
+        }
+    }
+
+    if (required) {
+        fprintf(stderr, "pio_claim_unused_sm: no state machine available\n");
+        abort();
+    }
+    return -1;
+}
+
+void pio_sm_unclaim(PIO pio, uint sm) {
+    pio->sm_claimed &= ~(1u << sm);
+}
+
+uint pio_add_program(PIO pio, const pio_program_t *program) {
+    uint offset = pio->program_offset;
+    pio->program_offset += program->length;
+    return offset;
+}
+
+/*
+ * DMA
+ */
+int dma_claim_unused_channel(bool required) {
+    for (int channel = 0; channel < NUM_DMA_CHANNELS; channel++) {
+        if (!dma_channels[channel].claimed) {
+            dma_channels[channel].claimed = true;
+            return channel;
+        }
+    }
+
+    if (required) {
+        fprintf(stderr, "dma_claim_unused_channel: no channel available\n");
+        abort();
+    }
+    return -1;
+}
+
+void dma_channel_unclaim(uint channel) {
+    dma_channels[channel].claimed = false;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+    (void)channel;
+    dma_channel_config config = {DMA_SIZE_32 | 0x4u};   // 32 bit, read increment
+    return config;
+}
+
+/*
+ * executes the transfer of a channel at once
+ */
+static void dma_channel_run(host_dma_channel_t *ch) {
+    uint size = 1u << (ch->config.ctrl & 0x3u);
+    const volatile uint8_t *src = (const volatile uint8_t *)ch->read_addr;
+    volatile uint8_t *dst = (volatile uint8_t *)ch->write_addr;
+
+    for (uint i = 0; i < ch->transfer_count; i++) {
+        for (uint b = 0; b < size; b++) {
+            dst[b] = src[b];
+        }
+        src += (ch->config.ctrl & 0x4u) ? size : 0;
+        dst += (ch->config.ctrl & 0x8u) ? size : 0;
+    }
+    dma_transfers++;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr, const volatile void *read_addr,
+                           uint transfer_count, bool trigger) {
+    host_dma_channel_t *ch = &dma_channels[channel];
+    ch->config = *config;
+    ch->write_addr = write_addr;
+    ch->read_addr = read_addr;
+    ch->transfer_count = transfer_count;
+    if (trigger) {
+        dma_channel_run(ch);
+    }
+}
+
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger) {
+    dma_channels[channel].read_addr = read_addr;
+    if (trigger) {
+        dma_channel_run(&dma_channels[channel]);
+    }
+}
+
+bool dma_channel_is_busy(uint channel) {
+    (void)channel;
+    return false;
+}
+
+uint32_t host_dma_transfer_count() {
+    return dma_transfers;
+}
+
+/*
+ * queue
+ */
+void host_set_queue_block_handler(host_queue_block_handler_t handler) {
+    queue_block_handler = handler;
+}
+
+void queue_init(queue_t *q, uint element_size, uint element_count) {
+    q->data = (uint8_t *)calloc(element_count + 1, element_size);
+    q->element_size = element_size;
+    q->element_count = element_count;
+    q->wptr = 0;
+    q->rptr = 0;
+}
+
+void queue_free(queue_t *q) {
+    free(q->data);
+    q->data = NULL;
+}
+
+uint queue_get_level(queue_t *q) {
+    int32_t level = (int32_t)q->wptr - (int32_t)q->rptr;
+    return level < 0 ? level + q->element_count + 1 : level;
+}
+
+bool queue_is_empty(queue_t *q) {
+    return q->wptr == q->rptr;
+}
+
+bool queue_is_full(queue_t *q) {
+    return queue_get_level(q) == q->element_count;
+}
+
+bool queue_try_add(queue_t *q, const void *data) {
+    if (queue_is_full(q)) {
+        return false;
+    }
+
+    memcpy(q->data + q->wptr * q->element_size, data, q->element_size);
+    q->wptr = (q->wptr + 1) % (q->element_count + 1);
+    return true;
+}
+
+bool queue_try_peek(queue_t *q, void *data) {
+    if (queue_is_empty(q)) {
+        return false;
+    }
+
+    memcpy(data, q->data + q->rptr * q->element_size, q->element_size);
+    return true;
+}
+
+bool queue_try_remove(queue_t *q, void *data) {
+    if (!queue_try_peek(q, data)) {
+        return false;
+    }
+
+    q->rptr = (q->rptr + 1) % (q->element_count + 1);
+    return true;
+}
+
+void queue_add_blocking(queue_t *q, const void *data) {
+    while (!queue_try_add(q, data)) {
+        if (!queue_block_handler) {
+            fprintf(stderr, "queue_add_blocking: queue full and no block handler set\n");
+            abort();
+        }
+        queue_block_handler();
+    }
+}
+
+void queue_remove_blocking(queue_t *q, void *data) {
+    while (!queue_try_remove(q, data)) {
+        if (!queue_block_handler) {
+            fprintf(stderr, "queue_remove_blocking: queue empty and no block handler set\n");
+            abort();
+        }
+        queue_block_handler();
+    }
+}
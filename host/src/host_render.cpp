@@ -0,0 +1,111 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "host_render.h"
+
+#include <cstring>
+
+#define WAV_HEADER_SIZE 44
+
+/*
+ * renders the next packet like the USB microphone callbacks
+ */
+void host_render_packet(CWGenerator *cwgen, int16_t *samples) {
+    memcpy(samples, cwgen->get_audio_buffer(), cwgen->get_audio_buffer_size());
+    cwgen->update_statemachine();
+    host_advance_time_us((uint64_t)HOST_SAMPLE_BUFFER_SIZE * 1000000 / HOST_SAMPLE_RATE);
+}
+
+/*
+ * writes a little endian value with the given number of bytes
+ */
+static void put_le(uint8_t *buf, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        buf[i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+/*
+ * writes the RIFF/WAVE header for the given number of data bytes
+ */
+static bool wav_write_header(FILE *wav, uint32_t sample_rate, uint32_t data_size) {
+    uint8_t header[WAV_HEADER_SIZE];
+
+    memcpy(header, "RIFF", 4);
+    put_le(header + 4, WAV_HEADER_SIZE - 8 + data_size, 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put_le(header + 16, 16, 4);                     // size of fmt chunk
+    put_le(header + 20, 1, 2);                      // PCM
+    put_le(header + 22, 1, 2);                      // mono
+    put_le(header + 24, sample_rate, 4);
+    put_le(header + 28, sample_rate * sizeof(int16_t), 4);
+    put_le(header + 32, sizeof(int16_t), 2);        // block align
+    put_le(header + 34, 16, 2);                     // bits per sample
+    memcpy(header + 36, "data", 4);
+    put_le(header + 40, data_size, 4);
+
+    return fwrite(header, 1, sizeof(header), wav) == sizeof(header);
+}
+
+bool wav_open(wav_file_t *wav, const char *path, uint32_t sample_rate) {
+    wav->file = fopen(path, "wb");
+    wav->sample_rate = sample_rate;
+    wav->data_size = 0;
+
+    if (wav->file == NULL) {
+        return false;
+    }
+    if (!wav_write_header(wav->file, sample_rate, 0)) {
+        fclose(wav->file);
+        wav->file = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool wav_write(wav_file_t *wav, const int16_t *samples, uint32_t count) {
+    uint8_t buf[2 * HOST_SAMPLE_BUFFER_SIZE];
+
+    while (count > 0) {
+        uint32_t n = count < HOST_SAMPLE_BUFFER_SIZE ? count : HOST_SAMPLE_BUFFER_SIZE;
+        for (uint32_t i = 0; i < n; i++) {
+            put_le(buf + 2 * i, (uint16_t)samples[i], 2);
+        }
+        if (fwrite(buf, 2, n, wav->file) != n) {
+            return false;
+        }
+        wav->data_size += 2 * n;
+        samples += n;
+        count -= n;
+    }
+    return true;
+}
+
+bool wav_close(wav_file_t *wav) {
+    bool ok = (fseek(wav->file, 0, SEEK_SET) == 0) && wav_write_header(wav->file, wav->sample_rate, wav->data_size);
+    ok = (fclose(wav->file) == 0) && ok;
+    wav->file = NULL;
+    return ok;
+}
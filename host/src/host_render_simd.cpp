@@ -0,0 +1,278 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "host_render_simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HOST_RENDER_X86
+#endif
+
+/*
+ * vectorized backends of cw_render_tone(). The backends render the samples of the element in blocks of 4 (SSE2)
+ * or 8 (AVX2) samples. Blocks in the sustained part of the element use the tone directly, blocks within the
+ * rise or fall time are multiplied by the envelope. The float to int16 conversion rounds half away from
+ * zero like roundf(). Remaining samples and unusual parameters are rendered by the scalar reference.
+ */
+
+static host_render_backend_t selected_backend = HOST_RENDER_BACKENDS;  // HOST_RENDER_BACKENDS: not yet selected
+
+/*
+ * scalar rendering of a single sample, identical to cw_render_tone()
+ */
+static inline int16_t render_sample(const cw_tone_params_t *params, uint32_t curpos) {
+    float curval = params->signal[curpos % params->signal_period];
+
+    if (curpos * params->keyshape_stepsize < params->keyshape_size) {
+        curval = curval * params->keyshape[curpos * params->keyshape_stepsize];
+    } else if ((params->end - curpos) * params->keyshape_stepsize < params->keyshape_size) {
+        curval = curval * params->keyshape[(params->end - curpos) * params->keyshape_stepsize];
+    }
+    return roundf(curval);
+}
+
+/*
+ * returns the number of samples at the beginning of the packet that are within the element.
+ * Returns 0 if the vectorized backends cannot be used (index overflow), the scalar reference is used instead
+ */
+static uint32_t vector_samples(const cw_tone_params_t *params, uint32_t count) {
+    if ((params->start >= params->end) || (params->start > UINT32_MAX - count) ||
+        ((uint64_t)params->end * params->keyshape_stepsize > INT32_MAX) || (params->signal_period < 8)) {
+        return 0;
+    }
+    return params->end - params->start < count ? params->end - params->start : count;
+}
+
+/*
+ * checks if all samples of the block [curpos, curpos + n) are in the sustained part of the element
+ */
+static inline bool block_sustained(const cw_tone_params_t *params, uint32_t curpos, uint32_t n) {
+    return (curpos * params->keyshape_stepsize >= params->keyshape_size) &&
+           ((params->end - (curpos + n - 1)) * params->keyshape_stepsize >= params->keyshape_size);
+}
+
+/*
+ * envelope factor of a sample (1 in the sustained part)
+ */
+static inline float envelope(const cw_tone_params_t *params, uint32_t curpos) {
+    if (curpos * params->keyshape_stepsize < params->keyshape_size) {
+        return params->keyshape[curpos * params->keyshape_stepsize];
+    } else if ((params->end - curpos) * params->keyshape_stepsize < params->keyshape_size) {
+        return params->keyshape[(params->end - curpos) * params->keyshape_stepsize];
+    }
+    return 1.0f;
+}
+
+#ifdef HOST_RENDER_X86
+/*
+ * rounds half away from zero like roundf(): truncate the absolute value and add 1 if the fraction is >= 0.5
+ */
+__attribute__((target("sse2"))) static inline __m128i round_sse2(__m128 v) {
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    __m128 abs = _mm_andnot_ps(sign_mask, v);
+    __m128i t = _mm_cvttps_epi32(abs);
+    __m128 frac = _mm_sub_ps(abs, _mm_cvtepi32_ps(t));
+    t = _mm_sub_epi32(t, _mm_castps_si128(_mm_cmpge_ps(frac, _mm_set1_ps(0.5f))));      // mask is -1
+    __m128i neg = _mm_castps_si128(_mm_cmplt_ps(v, _mm_setzero_ps()));
+    return _mm_sub_epi32(_mm_xor_si128(t, neg), neg);                                    // conditional negation
+}
+
+__attribute__((target("sse2"))) static void render_tone_sse2(const cw_tone_params_t *params, int16_t *out, uint32_t count) {
+    uint32_t n = vector_samples(params, count);
+    uint32_t phase = params->start % params->signal_period;
+    uint32_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        uint32_t curpos = params->start + i;
+        __m128 v[2];
+
+        // tone: contiguous load unless the period wraps within the block
+        for (int h = 0; h < 2; h++) {
+            uint32_t p = phase + 4 * h;
+            p = p >= params->signal_period ? p - params->signal_period : p;
+            if (p + 4 <= params->signal_period) {
+                v[h] = _mm_loadu_ps(params->signal + p);
+            } else {
+                float s[4];
+                for (int l = 0; l < 4; l++) {
+                    s[l] = params->signal[(p + l) % params->signal_period];
+                }
+                v[h] = _mm_loadu_ps(s);
+            }
+        }
+
+        if (!block_sustained(params, curpos, 8)) {
+            float env[8];
+            for (int l = 0; l < 8; l++) {
+                env[l] = envelope(params, curpos + l);
+            }
+            v[0] = _mm_mul_ps(v[0], _mm_loadu_ps(env));
+            v[1] = _mm_mul_ps(v[1], _mm_loadu_ps(env + 4));
+        }
+
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(round_sse2(v[0]), round_sse2(v[1])));
+
+        phase += 8;
+        phase = phase >= params->signal_period ? phase - params->signal_period : phase;
+    }
+
+    for (; i < count; i++) {
+        if (params->start + i < params->end) {
+            out[i] = render_sample(params, params->start + i);
+        }
+    }
+}
+
+__attribute__((target("avx2"))) static inline __m256i round_avx2(__m256 v) {
+    const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+    __m256 abs = _mm256_andnot_ps(sign_mask, v);
+    __m256i t = _mm256_cvttps_epi32(abs);
+    __m256 frac = _mm256_sub_ps(abs, _mm256_cvtepi32_ps(t));
+    t = _mm256_sub_epi32(t, _mm256_castps_si256(_mm256_cmp_ps(frac, _mm256_set1_ps(0.5f), _CMP_GE_OQ)));
+    __m256i neg = _mm256_castps_si256(_mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_LT_OQ));
+    return _mm256_sub_epi32(_mm256_xor_si256(t, neg), neg);
+}
+
+__attribute__((target("avx2"))) static void render_tone_avx2(const cw_tone_params_t *params, int16_t *out, uint32_t count) {
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i period = _mm256_set1_epi32(params->signal_period);
+    const __m256i step = _mm256_set1_epi32(params->keyshape_stepsize);
+    const __m256i size = _mm256_set1_epi32(params->keyshape_size);
+    const __m256i end = _mm256_set1_epi32(params->end);
+    uint32_t n = vector_samples(params, count);
+    uint32_t phase = params->start % params->signal_period;
+    uint32_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        uint32_t curpos = params->start + i;
+        __m256 v;
+
+        // tone: contiguous load unless the period wraps within the block
+        if (phase + 8 <= params->signal_period) {
+            v = _mm256_loadu_ps(params->signal + phase);
+        } else {
+            __m256i idx = _mm256_add_epi32(_mm256_set1_epi32(phase), lanes);
+            idx = _mm256_sub_epi32(idx, _mm256_and_si256(_mm256_cmpgt_epi32(idx, _mm256_sub_epi32(period, _mm256_set1_epi32(1))), period));
+            v = _mm256_i32gather_ps(params->signal, idx, 4);
+        }
+
+        // envelope: gather from the key shape within the rise and fall time (indices < 2^31, see vector_samples())
+        if (!block_sustained(params, curpos, 8)) {
+            __m256i pos = _mm256_add_epi32(_mm256_set1_epi32(curpos), lanes);
+            __m256i rise = _mm256_mullo_epi32(pos, step);
+            __m256i fall = _mm256_mullo_epi32(_mm256_sub_epi32(end, pos), step);
+            __m256i in_rise = _mm256_cmpgt_epi32(size, rise);
+            __m256i in_fall = _mm256_andnot_si256(in_rise, _mm256_cmpgt_epi32(size, fall));
+            __m256i idx = _mm256_blendv_epi8(fall, rise, in_rise);
+            __m256i mask = _mm256_or_si256(in_rise, in_fall);
+            __m256 env = _mm256_mask_i32gather_ps(_mm256_set1_ps(1.0f), params->keyshape, idx, _mm256_castsi256_ps(mask), 4);
+            v = _mm256_mul_ps(v, env);
+        }
+
+        __m256i r = round_avx2(v);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(_mm256_castsi256_si128(r), _mm256_extracti128_si256(r, 1)));
+
+        phase += 8;
+        phase = phase >= params->signal_period ? phase - params->signal_period : phase;
+    }
+
+    for (; i < count; i++) {
+        if (params->start + i < params->end) {
+            out[i] = render_sample(params, params->start + i);
+        }
+    }
+}
+#endif
+
+void host_render_tone_backend(host_render_backend_t backend, const cw_tone_params_t *params, int16_t *out, uint32_t count) {
+    switch (backend) {
+#ifdef HOST_RENDER_X86
+        case HOST_RENDER_SSE2:
+            render_tone_sse2(params, out, count);
+            break;
+        case HOST_RENDER_AVX2:
+            render_tone_avx2(params, out, count);
+            break;
+#endif
+        default:
+            cw_render_tone(params, out, count);
+            break;
+    }
+}
+
+/*
+ * selects the fastest backend supported by the CPU if no backend was selected yet
+ */
+static void select_default_backend() {
+    if (selected_backend != HOST_RENDER_BACKENDS) {
+        return;
+    }
+
+    selected_backend = HOST_RENDER_SCALAR;
+    for (int b = HOST_RENDER_BACKENDS - 1; b > HOST_RENDER_SCALAR; b--) {
+        if (host_render_supported((host_render_backend_t)b)) {
+            selected_backend = (host_render_backend_t)b;
+            break;
+        }
+    }
+}
+
+void host_render_tone(const cw_tone_params_t *params, int16_t *out, uint32_t count) {
+    select_default_backend();
+    host_render_tone_backend(selected_backend, params, out, count);
+}
+
+bool host_render_supported(host_render_backend_t backend) {
+    switch (backend) {
+        case HOST_RENDER_SCALAR:
+            return true;
+#ifdef HOST_RENDER_X86
+        case HOST_RENDER_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case HOST_RENDER_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+bool host_render_set_backend(host_render_backend_t backend) {
+    if (!host_render_supported(backend)) {
+        return false;
+    }
+    selected_backend = backend;
+    return true;
+}
+
+host_render_backend_t host_render_get_backend() {
+    select_default_backend();
+    return selected_backend;
+}
+
+const char *host_render_backend_name(host_render_backend_t backend) {
+    static const char *NAMES[] = {"scalar", "sse2", "avx2"};
+    return backend < HOST_RENDER_BACKENDS ? NAMES[backend] : "unknown";
+}
@@ -0,0 +1,80 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "keyer_analysis.h"
+
+/*
+ * splits the samples into tones and gaps
+ */
+std::vector<keyer_segment_t> keyer_detect_segments(const std::vector<int16_t> &samples, uint32_t merge_gap) {
+    std::vector<keyer_segment_t> segments;
+    bool in_tone = false;
+    uint32_t tone_start = 0;
+    uint32_t last_nonzero = 0;
+
+    for (uint32_t i = 0; i < samples.size(); i++) {
+        if (samples[i] == 0) {
+            continue;
+        }
+
+        if (in_tone && (i - last_nonzero - 1 > merge_gap)) {
+            keyer_segment_t tone = {true, tone_start, last_nonzero + 1 - tone_start};
+            keyer_segment_t gap = {false, last_nonzero + 1, i - last_nonzero - 1};
+            segments.push_back(tone);
+            segments.push_back(gap);
+            tone_start = i;
+        } else if (!in_tone) {
+            in_tone = true;
+            tone_start = i;
+        }
+        last_nonzero = i;
+    }
+
+    if (in_tone) {
+        keyer_segment_t tone = {true, tone_start, last_nonzero + 1 - tone_start};
+        segments.push_back(tone);
+    }
+    return segments;
+}
+
+/*
+ * converts the segments into morse notation
+ */
+std::string keyer_segments_to_morse(const std::vector<keyer_segment_t> &segments, double unit) {
+    std::string morse;
+
+    for (size_t i = 0; i < segments.size(); i++) {
+        double units = segments[i].length / unit;
+
+        if (segments[i].tone) {
+            morse += units < 2 ? '.' : '-';
+        } else if (units >= 5) {
+            morse += " / ";
+        } else if (units >= 2) {
+            morse += ' ';
+        }
+    }
+    return morse;
+}
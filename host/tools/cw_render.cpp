@@ -0,0 +1,216 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * renders text files to WAV files using the CWGenerator and the WinKeyerParser of the firmware.
+ * The output matches the audio sent by the device, including the pause after the stream starts.
+ * Each file is rendered in a separate worker process, up to <jobs> files in parallel.
+ *
+ * usage: cw_render [-w wpm] [-f frequency] [-r risetime] [-v volume] [-j jobs] [-o outdir] file.txt...
+ */
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "cw_generator.h"
+#include "host_render.h"
+#include "winkeyer_parser.h"
+
+#define READ_CHUNK_SIZE 64                  // text is passed to the parser in chunks like CDC reads
+
+// render settings
+typedef struct {
+    uint16_t wpm;
+    uint16_t frequency;
+    float risetime;
+    uint16_t volume;
+    std::string outdir;
+} render_config_t;
+
+static CWGenerator *render_cwgen;           // generator of the current worker
+static wav_file_t render_wav;               // output of the current worker
+static bool render_ok;
+
+/*
+ * renders a single packet to the output file
+ */
+static void render_packet() {
+    int16_t samples[HOST_SAMPLE_BUFFER_SIZE];
+
+    host_render_packet(render_cwgen, samples);
+    render_ok = wav_write(&render_wav, samples, HOST_SAMPLE_BUFFER_SIZE) && render_ok;
+}
+
+/*
+ * returns the name of the output file: <outdir>/<basename without extension>.wav
+ */
+static std::string output_path(const std::string &input, const std::string &outdir) {
+    std::string name = input;
+    size_t slash = name.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "" : name.substr(0, slash + 1);
+    name = slash == std::string::npos ? name : name.substr(slash + 1);
+
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos && dot > 0) {
+        name = name.substr(0, dot);
+    }
+    return (outdir.empty() ? dir : outdir + "/") + name + ".wav";
+}
+
+/*
+ * renders a text file to a WAV file
+ * @return 0 on success
+ */
+static int render_file(const std::string &input, const render_config_t *config) {
+    FILE *in = fopen(input.c_str(), "rb");
+    if (in == NULL) {
+        fprintf(stderr, "%s: cannot open\n", input.c_str());
+        return 1;
+    }
+
+    std::string output = output_path(input, config->outdir);
+    if (!wav_open(&render_wav, output.c_str(), HOST_SAMPLE_RATE)) {
+        fprintf(stderr, "%s: cannot create\n", output.c_str());
+        fclose(in);
+        return 1;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    render_cwgen = new CWGenerator(HOST_SAMPLE_RATE, HOST_SAMPLE_BUFFER_SIZE, config->frequency, config->wpm, config->volume, config->risetime);
+    WinKeyerParser parser(render_cwgen);
+    render_ok = true;
+
+    // the parser blocks on a full character queue until the audio callbacks consumed enough characters
+    host_set_queue_block_handler(render_packet);
+
+    uint8_t buf[READ_CHUNK_SIZE];
+    size_t count;
+    while ((count = fread(buf, 1, sizeof(buf), in)) > 0) {
+        for (size_t i = 0; i < count; i++) {
+            if (buf[i] < WinKeyerParser::cw_mapping_min_ascii) {
+                buf[i] = ' ';                                   // line breaks and tabs are pauses, not commands
+            }
+        }
+        parser.parse_message(buf, count, sizeof(buf));
+    }
+    fclose(in);
+
+    while (render_cwgen->is_busy()) {
+        render_packet();
+    }
+    render_packet();                                            // last packet of the final pause
+
+    host_set_queue_block_handler(NULL);
+    delete render_cwgen;
+    render_ok = wav_close(&render_wav) && render_ok;
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double duration = render_wav.data_size / (2.0 * HOST_SAMPLE_RATE);
+    printf("%s -> %s: %.1f s audio in %.3f s (%.0fx real time)\n", input.c_str(), output.c_str(),
+           duration, elapsed, elapsed > 0 ? duration / elapsed : 0);
+
+    if (!render_ok) {
+        fprintf(stderr, "%s: write error\n", output.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: cw_render [-w wpm] [-f frequency] [-r risetime] [-v volume] [-j jobs] [-o outdir] file.txt...\n");
+}
+
+int main(int argc, char **argv) {
+    render_config_t config = {DEFAULT_WPM, DEFAULT_FREQUENCY, DEFAULT_RISETIME, DEFAULT_VOLUME, ""};
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+
+    while ((opt = getopt(argc, argv, "w:f:r:v:j:o:h")) != -1) {
+        switch (opt) {
+            case 'w':
+                config.wpm = atoi(optarg);
+                break;
+            case 'f':
+                config.frequency = atoi(optarg);
+                break;
+            case 'r':
+                config.risetime = atof(optarg);
+                break;
+            case 'v':
+                config.volume = atoi(optarg);
+                break;
+            case 'j':
+                jobs = atol(optarg);
+                break;
+            case 'o':
+                config.outdir = optarg;
+                break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        usage();
+        return 1;
+    }
+    jobs = jobs < 1 ? 1 : jobs;
+    fflush(stdout);
+
+    // one worker process per file, at most <jobs> running at the same time
+    int failed = 0;
+    long running = 0;
+    for (int i = optind; i < argc; i++) {
+        if (running == jobs) {
+            int status;
+            wait(&status);
+            failed += !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+            running--;
+        }
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            exit(render_file(argv[i], &config));
+        } else if (pid < 0) {
+            failed += render_file(argv[i], &config);
+        } else {
+            running++;
+        }
+    }
+    while (running > 0) {
+        int status;
+        wait(&status);
+        failed += !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        running--;
+    }
+
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,251 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * key-click analysis: renders an element sequence through the CWGenerator for each combination of envelope,
+ * rise time and speed and computes the averaged power spectrum (Welch, Blackman-Harris window). Reports the
+ * bandwidth around the tone that contains all components above -20/-40/-60 dB relative to the peak, and
+ * the host time per rendered packet. Results are printed as CSV.
+ *
+ * usage: keyclick [-e envelopes] [-r risetimes_ms] [-w wpms] [-t text] [-n fft_size]
+ *        lists are comma separated, envelopes: blackman-harris,blackman,raised-cosine,linear
+ */
+
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <complex>
+#include <string>
+#include <vector>
+
+#include "cw_generator.h"
+#include "host_platform.h"
+#include "host_render.h"
+#include "winkeyer_parser.h"
+
+#define DEFAULT_TEXT "PARIS PARIS PARIS "
+#define DEFAULT_FFT_SIZE 16384                  // ~2.9 Hz resolution at 48 kHz
+
+static const char *ENVELOPE_NAMES[] = {"blackman-harris", "blackman", "raised-cosine", "linear"};
+static const int NR_ENVELOPES = sizeof(ENVELOPE_NAMES) / sizeof(ENVELOPE_NAMES[0]);
+static const double LEVELS_DB[] = {20, 40, 60};
+
+/*
+ * in-place radix-2 FFT
+ */
+static void fft(std::vector<std::complex<double>> &x) {
+    size_t n = x.size();
+
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            std::swap(x[i], x[j]);
+        }
+    }
+    for (size_t len = 2; len <= n; len <<= 1) {
+        std::complex<double> w_len = std::polar(1.0, -2 * M_PI / len);
+        for (size_t i = 0; i < n; i += len) {
+            std::complex<double> w = 1;
+            for (size_t k = 0; k < len / 2; k++) {
+                std::complex<double> u = x[i + k];
+                std::complex<double> v = x[i + k + len / 2] * w;
+                x[i + k] = u + v;
+                x[i + k + len / 2] = u - v;
+                w *= w_len;
+            }
+        }
+    }
+}
+
+/*
+ * averaged power spectrum of the samples with 50% overlapping Blackman-Harris windowed segments
+ */
+static std::vector<double> power_spectrum(const std::vector<int16_t> &samples, size_t n) {
+    std::vector<double> window(n);
+    std::vector<double> power(n / 2 + 1, 0);
+    std::vector<std::complex<double>> x(n);
+
+    for (size_t i = 0; i < n; i++) {
+        window[i] = 0.35875 - 0.48829 * cos(2 * M_PI * i / n) + 0.14128 * cos(4 * M_PI * i / n) - 0.01168 * cos(6 * M_PI * i / n);
+    }
+    for (size_t start = 0; start + n <= samples.size(); start += n / 2) {
+        for (size_t i = 0; i < n; i++) {
+            x[i] = samples[start + i] * window[i];
+        }
+        fft(x);
+        for (size_t i = 0; i <= n / 2; i++) {
+            power[i] += std::norm(x[i]);
+        }
+    }
+    return power;
+}
+
+/*
+ * bandwidth containing all spectral components above the given level relative to the peak
+ * @return bandwidth in Hz
+ */
+static double bandwidth(const std::vector<double> &power, size_t n, double level_db) {
+    size_t peak = 0;
+    for (size_t i = 1; i < power.size(); i++) {
+        peak = power[i] > power[peak] ? i : peak;
+    }
+
+    double threshold = power[peak] * pow(10, -level_db / 10);
+    size_t lo = peak;
+    size_t hi = peak;
+    for (size_t i = 0; i < power.size(); i++) {
+        if (power[i] >= threshold) {
+            lo = i < lo ? i : lo;
+            hi = i > hi ? i : hi;
+        }
+    }
+    return (double)(hi - lo) * HOST_SAMPLE_RATE / n;
+}
+
+/*
+ * renders the text and returns the samples from the first to the last tone
+ * @param ns_per_packet: host time per rendered packet
+ */
+static std::vector<int16_t> render(CWGenerator *cwgen, WinKeyerParser *parser, const std::string &text, double *ns_per_packet) {
+    std::vector<int16_t> samples;
+    int16_t packet[HOST_SAMPLE_BUFFER_SIZE];
+    std::vector<uint8_t> buf(text.begin(), text.end());
+    uint64_t packets = 0;
+
+    parser->parse_message(buf.data(), buf.size(), buf.size());
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (cwgen->is_busy()) {
+        host_render_packet(cwgen, packet);
+        samples.insert(samples.end(), packet, packet + HOST_SAMPLE_BUFFER_SIZE);
+        packets++;
+    }
+    *ns_per_packet = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / packets;
+
+    size_t first = 0;
+    size_t last = samples.size();
+    while ((first < last) && (samples[first] == 0)) {
+        first++;
+    }
+    while ((last > first) && (samples[last - 1] == 0)) {
+        last--;
+    }
+    return std::vector<int16_t>(samples.begin() + first, samples.begin() + last);
+}
+
+static std::vector<std::string> split(const char *list) {
+    std::vector<std::string> items;
+    std::string s(list);
+    size_t pos;
+
+    while ((pos = s.find(',')) != std::string::npos) {
+        items.push_back(s.substr(0, pos));
+        s = s.substr(pos + 1);
+    }
+    items.push_back(s);
+    return items;
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> envelopes(ENVELOPE_NAMES, ENVELOPE_NAMES + NR_ENVELOPES);
+    std::vector<std::string> risetimes = split("1,2,5,10,15,20");
+    std::vector<std::string> wpms = split("15,25,40");
+    std::string text = DEFAULT_TEXT;
+    size_t fft_size = DEFAULT_FFT_SIZE;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "e:r:w:t:n:h")) != -1) {
+        switch (opt) {
+            case 'e':
+                envelopes = split(optarg);
+                break;
+            case 'r':
+                risetimes = split(optarg);
+                break;
+            case 'w':
+                wpms = split(optarg);
+                break;
+            case 't':
+                text = optarg;
+                break;
+            case 'n':
+                fft_size = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: keyclick [-e envelopes] [-r risetimes_ms] [-w wpms] [-t text] [-n fft_size]\n");
+                return 1;
+        }
+    }
+    if ((fft_size < 256) || (fft_size & (fft_size - 1))) {
+        fprintf(stderr, "fft size must be a power of two >= 256\n");
+        return 1;
+    }
+
+    CWGenerator *cwgen = new CWGenerator(HOST_SAMPLE_RATE, HOST_SAMPLE_BUFFER_SIZE);
+    WinKeyerParser *parser = new WinKeyerParser(cwgen);
+    double ns;
+
+    printf("envelope,risetime_ms,wpm,bw20_hz,bw40_hz,bw60_hz,ns_per_packet\n");
+    for (const std::string &envelope : envelopes) {
+        int e = 0;
+        while ((e < NR_ENVELOPES) && (envelope != ENVELOPE_NAMES[e])) {
+            e++;
+        }
+        if (e == NR_ENVELOPES) {
+            fprintf(stderr, "unknown envelope %s\n", envelope.c_str());
+            return 1;
+        }
+
+        for (const std::string &risetime : risetimes) {
+            for (const std::string &wpm : wpms) {
+                cwgen->reset();
+                cwgen->set_envelope((CWGenerator::CW_ENVELOPE)e);
+                cwgen->set_risetime(atof(risetime.c_str()));
+                cwgen->set_wpm(atoi(wpm.c_str()));
+
+                std::vector<int16_t> samples = render(cwgen, parser, text, &ns);
+                if (samples.size() < fft_size) {
+                    fprintf(stderr, "%s %s ms %s WPM: rendered signal shorter than the FFT size\n", envelope.c_str(), risetime.c_str(), wpm.c_str());
+                    return 1;
+                }
+
+                std::vector<double> power = power_spectrum(samples, fft_size);
+                printf("%s,%g,%u", envelope.c_str(), cwgen->get_risetime(), cwgen->get_wpm());
+                for (double level : LEVELS_DB) {
+                    printf(",%.1f", bandwidth(power, fft_size, level));
+                }
+                printf(",%.1f\n", ns);
+            }
+        }
+    }
+
+    delete parser;
+    delete cwgen;
+    return 0;
+}
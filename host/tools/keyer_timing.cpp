@@ -0,0 +1,291 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * keyer timing conformance suite. For every speed from WPM_MIN to WPM_MAX the text "PARIS PARIS" is
+ * sent through the WinKeyerParser, the element and gap durations are recovered from the rendered
+ * audio and compared against the ideal PARIS timing (DIT = 1200 / WPM ms). In addition, scripted paddle
+ * timelines check the iambic squeeze and memory behaviour of update_statemachine().
+ *
+ * The timing statistics are printed as CSV: wpm,class,count,ideal_ms,mean_ms,mean_err_pct,max_abs_err_pct
+ * The exit code is non-zero if a recovered element sequence differs from the expected one or if a
+ * mean timing error exceeds the tolerance given with -t.
+ *
+ * usage: keyer_timing [-w wpm] [-t tolerance_pct] [-s]
+ *   -w wpm: only test the given speed
+ *   -t tolerance_pct: maximum allowed mean timing error in percent of the ideal duration
+ *   -s: only print the summary (worst case over all speeds)
+ */
+
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "cw_generator.h"
+#include "host_render.h"
+#include "keyer_analysis.h"
+#include "winkeyer_parser.h"
+
+#define PARIS_TEXT "PARIS PARIS"
+#define PARIS_MORSE ".--. .- .-. .. ... / .--. .- .-. .. ..."
+
+// classes of recovered durations and their ideal length in units
+typedef enum {
+    CLASS_DIT,
+    CLASS_DAH,
+    CLASS_ELEMENT_GAP,
+    CLASS_CHAR_GAP,
+    CLASS_WORD_GAP,
+    NR_CLASSES
+} timing_class_t;
+
+static const char *CLASS_NAMES[NR_CLASSES] = {"dit", "dah", "element_gap", "char_gap", "word_gap"};
+static const double CLASS_UNITS[NR_CLASSES] = {DIT_UNITS, DAH_UNITS, INTRA_CHAR_PAUSE_UNITS, INTER_CHAR_PAUSE_UNITS, INT_WORD_PAUSE_UNITS};
+
+// timing statistics of a class
+typedef struct {
+    uint32_t count;
+    double sum_ms;
+    double max_abs_err_pct;
+} timing_stats_t;
+
+// scripted paddle event, times in units
+typedef struct {
+    double time;
+    uint gpio;
+    bool level;
+} paddle_step_t;
+
+// paddle scenario and the element sequence expected from an iambic keyer with element memory
+typedef struct {
+    const char *name;
+    std::vector<paddle_step_t> steps;
+    const char *expected;
+} paddle_scenario_t;
+
+#define DOWN false                          // paddles are active low
+#define UP true
+
+static const paddle_scenario_t PADDLE_SCENARIOS[] = {
+    {"dit_hold", {{0, DIT_GPIO, DOWN}, {6.5, DIT_GPIO, UP}}, "...."},
+    {"dah_hold", {{0, DAH_GPIO, DOWN}, {9.5, DAH_GPIO, UP}}, "---"},
+    {"squeeze_dit_first", {{0, DIT_GPIO, DOWN}, {0.5, DAH_GPIO, DOWN}, {6.5, DIT_GPIO, UP}, {6.5, DAH_GPIO, UP}}, ".-."},
+    {"squeeze_dah_first", {{0, DAH_GPIO, DOWN}, {0.5, DIT_GPIO, DOWN}, {7.5, DIT_GPIO, UP}, {7.5, DAH_GPIO, UP}}, "-.-"},
+    {"dah_memory", {{0, DIT_GPIO, DOWN}, {0.5, DIT_GPIO, UP}, {0.8, DAH_GPIO, DOWN}, {0.95, DAH_GPIO, UP}}, ".-"},
+    {"dit_memory", {{0, DAH_GPIO, DOWN}, {0.5, DAH_GPIO, UP}, {2.5, DIT_GPIO, DOWN}, {2.9, DIT_GPIO, UP}}, "-."},
+    {"early_tap_ignored", {{0, DIT_GPIO, DOWN}, {0.5, DIT_GPIO, UP}, {0.2, DAH_GPIO, DOWN}, {0.4, DAH_GPIO, UP}}, "."},
+};
+
+static const uint16_t PADDLE_WPM[] = {15, 25, 40};
+
+/*
+ * returns the length of a unit (DIT) in samples
+ */
+static double unit_samples(uint16_t wpm) {
+    return 60.0 / (50.0 * wpm) * HOST_SAMPLE_RATE;
+}
+
+/*
+ * renders packets until the keyer is idle
+ */
+static void render_until_idle(CWGenerator *cwgen, std::vector<int16_t> *samples) {
+    int16_t packet[HOST_SAMPLE_BUFFER_SIZE];
+
+    do {
+        host_render_packet(cwgen, packet);
+        samples->insert(samples->end(), packet, packet + HOST_SAMPLE_BUFFER_SIZE);
+    } while (cwgen->is_busy());
+}
+
+/*
+ * converts the expected morse notation into the sequence of timing classes
+ */
+static std::vector<timing_class_t> expected_classes(const std::string &morse) {
+    std::vector<timing_class_t> classes;
+
+    for (size_t i = 0; i < morse.size(); i++) {
+        if ((morse[i] == '.') || (morse[i] == '-')) {
+            if (!classes.empty() && ((classes.back() == CLASS_DIT) || (classes.back() == CLASS_DAH))) {
+                classes.push_back(CLASS_ELEMENT_GAP);
+            }
+            classes.push_back(morse[i] == '.' ? CLASS_DIT : CLASS_DAH);
+        } else if (morse.compare(i, 3, " / ") == 0) {
+            classes.push_back(CLASS_WORD_GAP);
+            i += 2;
+        } else if (morse[i] == ' ') {
+            classes.push_back(CLASS_CHAR_GAP);
+        }
+    }
+    return classes;
+}
+
+/*
+ * sends PARIS at the given speed and collects the timing statistics
+ * @return false if the recovered element sequence is wrong
+ */
+static bool run_paris(CWGenerator *cwgen, WinKeyerParser *parser, uint16_t wpm, timing_stats_t *stats) {
+    std::vector<int16_t> samples;
+    uint8_t text[] = PARIS_TEXT;
+
+    cwgen->reset();
+    cwgen->set_wpm(wpm);
+    parser->parse_message(text, strlen(PARIS_TEXT), sizeof(text));
+    render_until_idle(cwgen, &samples);
+
+    double unit = unit_samples(wpm);
+    std::vector<keyer_segment_t> segments = keyer_detect_segments(samples, 2 * HOST_SAMPLE_RATE / cwgen->get_frequency());
+    std::string morse = keyer_segments_to_morse(segments, unit);
+    if (morse != PARIS_MORSE) {
+        fprintf(stderr, "%u WPM: expected \"%s\", got \"%s\"\n", wpm, PARIS_MORSE, morse.c_str());
+        return false;
+    }
+
+    std::vector<timing_class_t> classes = expected_classes(PARIS_MORSE);
+    for (size_t i = 0; i < segments.size(); i++) {
+        double ms = segments[i].length * 1000.0 / HOST_SAMPLE_RATE;
+        double ideal_ms = CLASS_UNITS[classes[i]] * unit * 1000.0 / HOST_SAMPLE_RATE;
+        double err_pct = fabs(ms - ideal_ms) / ideal_ms * 100;
+
+        timing_stats_t *s = &stats[classes[i]];
+        s->count++;
+        s->sum_ms += ms;
+        s->max_abs_err_pct = std::max(s->max_abs_err_pct, err_pct);
+    }
+    return true;
+}
+
+/*
+ * runs a paddle scenario at the given speed
+ * @return false if the recovered element sequence differs from the expected one
+ */
+static bool run_paddle(CWGenerator *cwgen, const paddle_scenario_t *scenario, uint16_t wpm) {
+    std::vector<paddle_step_t> steps = scenario->steps;
+    std::vector<int16_t> samples;
+    int16_t packet[HOST_SAMPLE_BUFFER_SIZE];
+    double unit_us = 60.0 / (50.0 * wpm) * 1e6;
+
+    std::stable_sort(steps.begin(), steps.end(), [](const paddle_step_t &a, const paddle_step_t &b) { return a.time < b.time; });
+
+    cwgen->reset();
+    cwgen->set_wpm(wpm);
+    uint64_t t0 = time_us_64();
+    size_t next = 0;
+
+    while ((next < steps.size()) || cwgen->is_busy()) {
+        while ((next < steps.size()) && (t0 + steps[next].time * unit_us <= time_us_64())) {
+            host_gpio_set(steps[next].gpio, steps[next].level);
+            next++;
+        }
+        host_render_packet(cwgen, packet);
+        samples.insert(samples.end(), packet, packet + HOST_SAMPLE_BUFFER_SIZE);
+    }
+    render_until_idle(cwgen, &samples);
+
+    std::vector<keyer_segment_t> segments = keyer_detect_segments(samples, 2 * HOST_SAMPLE_RATE / cwgen->get_frequency());
+    std::string morse = keyer_segments_to_morse(segments, unit_samples(wpm));
+    bool ok = morse == scenario->expected;
+
+    printf("# paddle %s %u WPM: expected \"%s\", got \"%s\" %s\n", scenario->name, wpm, scenario->expected, morse.c_str(), ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    uint16_t wpm_first = WPM_MIN;
+    uint16_t wpm_last = WPM_MAX;
+    double tolerance = -1;
+    bool summary_only = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "w:t:sh")) != -1) {
+        switch (opt) {
+            case 'w':
+                wpm_first = wpm_last = atoi(optarg);
+                break;
+            case 't':
+                tolerance = atof(optarg);
+                break;
+            case 's':
+                summary_only = true;
+                break;
+            default:
+                fprintf(stderr, "usage: keyer_timing [-w wpm] [-t tolerance_pct] [-s]\n");
+                return 1;
+        }
+    }
+
+    CWGenerator *cwgen = new CWGenerator(HOST_SAMPLE_RATE, HOST_SAMPLE_BUFFER_SIZE);
+    WinKeyerParser parser(cwgen);
+
+    int failures = 0;
+    double worst_mean_err[NR_CLASSES] = {0};
+    double worst_max_err[NR_CLASSES] = {0};
+
+    printf("wpm,class,count,ideal_ms,mean_ms,mean_err_pct,max_abs_err_pct\n");
+    for (uint16_t wpm = wpm_first; wpm <= wpm_last; wpm++) {
+        timing_stats_t stats[NR_CLASSES];
+        memset(stats, 0, sizeof(stats));
+
+        if (!run_paris(cwgen, &parser, wpm, stats)) {
+            failures++;
+            continue;
+        }
+
+        for (int c = 0; c < NR_CLASSES; c++) {
+            double ideal_ms = CLASS_UNITS[c] * 1200.0 / wpm;
+            double mean_ms = stats[c].count > 0 ? stats[c].sum_ms / stats[c].count : 0;
+            double mean_err = (mean_ms - ideal_ms) / ideal_ms * 100;
+
+            if (!summary_only) {
+                printf("%u,%s,%u,%.3f,%.3f,%.2f,%.2f\n", wpm, CLASS_NAMES[c], stats[c].count, ideal_ms, mean_ms, mean_err, stats[c].max_abs_err_pct);
+            }
+            if (fabs(mean_err) > fabs(worst_mean_err[c])) {
+                worst_mean_err[c] = mean_err;
+            }
+            worst_max_err[c] = std::max(worst_max_err[c], stats[c].max_abs_err_pct);
+            if ((tolerance >= 0) && (fabs(mean_err) > tolerance)) {
+                fprintf(stderr, "%u WPM: %s mean error %.2f%% exceeds tolerance\n", wpm, CLASS_NAMES[c], mean_err);
+                failures++;
+            }
+        }
+    }
+
+    for (int c = 0; c < NR_CLASSES; c++) {
+        printf("# worst %s: mean_err_pct=%.2f max_abs_err_pct=%.2f\n", CLASS_NAMES[c], worst_mean_err[c], worst_max_err[c]);
+    }
+
+    for (size_t s = 0; s < sizeof(PADDLE_SCENARIOS) / sizeof(PADDLE_SCENARIOS[0]); s++) {
+        for (size_t w = 0; w < sizeof(PADDLE_WPM) / sizeof(PADDLE_WPM[0]); w++) {
+            failures += run_paddle(cwgen, &PADDLE_SCENARIOS[s], PADDLE_WPM[w]) ? 0 : 1;
+        }
+    }
+
+    printf("# %d failures\n", failures);
+    delete cwgen;
+    return failures > 0 ? 1 : 0;
+}
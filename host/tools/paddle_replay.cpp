@@ -0,0 +1,226 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * replays raw paddle edges captured on the device (admin command 0x21) through the debouncer emulation
+ * and CWGenerator::update_statemachine() and compares the keyed elements with a reference. The reference
+ * of "<capture>" is stored in "<capture>.ref" as morse notation ('.', '-', ' ' between characters and " / "
+ * between words). With -u the references are (re)written from the current keyer.
+ *
+ * usage: paddle_replay [-w wpm] [-u] capture...
+ */
+
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "cw_generator.h"
+#include "host_platform.h"
+#include "host_render.h"
+#include "keyer_analysis.h"
+
+#define REPLAY_START_US 100000              // start of the replay, the debounced paddles settle to released before
+#define REPLAY_TAIL_US 500000               // rendered time after the last edge
+
+// raw paddle edge
+typedef struct {
+    uint32_t time;                          // time since start of the capture [us]
+    uint gpio;                              // DIT_GPIO or DAH_GPIO
+    bool pressed;                           // contact closed
+} paddle_edge_t;
+
+static double unit_samples(uint16_t wpm) {
+    return 60.0 / (50.0 * wpm) * HOST_SAMPLE_RATE;
+}
+
+/*
+ * reads a capture file
+ * @param wpm: set to the speed found in the header, unchanged if there is none
+ * @return false if the file cannot be read or contains an invalid line
+ */
+static bool read_capture(const char *path, std::vector<paddle_edge_t> *edges, uint16_t *wpm) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "%s: cannot read\n", path);
+        return false;
+    }
+
+    char line[256];
+    int lineno = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *comment = strchr(line, '#');
+        if (comment) {
+            char *w = strstr(comment, "wpm=");
+            if (w && (atoi(w + 4) > 0)) {
+                *wpm = atoi(w + 4);
+            }
+            *comment = 0;
+        }
+
+        unsigned long time;
+        char paddle[8];
+        char level[8];
+        int n = sscanf(line, "%lu %7s %7s", &time, paddle, level);
+        if (n <= 0) {
+            continue;                               // empty line or comment
+        }
+        paddle_edge_t edge = {(uint32_t)time, strcmp(paddle, "dah") == 0 ? (uint)DAH_GPIO : (uint)DIT_GPIO, strcmp(level, "down") == 0};
+        if ((n != 3) || ((strcmp(paddle, "dit") != 0) && (strcmp(paddle, "dah") != 0)) ||
+            ((strcmp(level, "down") != 0) && (strcmp(level, "up") != 0)) || (!edges->empty() && (edge.time < edges->back().time))) {
+            fprintf(stderr, "%s:%d: invalid edge\n", path, lineno);
+            ok = false;
+        }
+        edges->push_back(edge);
+    }
+    fclose(f);
+    return ok;
+}
+
+/*
+ * reads the reference of a capture
+ * @return false if there is no reference
+ */
+static bool read_reference(const std::string &path, std::string *morse) {
+    FILE *f = fopen(path.c_str(), "r");
+    if (f == NULL) {
+        return false;
+    }
+
+    char line[4096];
+    morse->clear();
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#') {
+            continue;
+        }
+        line[strcspn(line, "\r\n")] = 0;
+        *morse += line;
+    }
+    fclose(f);
+    return true;
+}
+
+/*
+ * replays the edges with the timing of the capture and returns the keyed elements in morse notation
+ */
+static std::string replay(CWGenerator *cwgen, const std::vector<paddle_edge_t> &edges, uint16_t wpm) {
+    std::vector<int16_t> samples;
+    int16_t packet[HOST_SAMPLE_BUFFER_SIZE];
+
+    cwgen->set_wpm(wpm);
+    host_gpio_set(DIT_GPIO, true);
+    host_gpio_set(DAH_GPIO, true);
+    while (time_us_64() < REPLAY_START_US) {
+        host_render_packet(cwgen, packet);
+    }
+
+    // edges are applied at their exact time between the packets, the keyer samples the debounced paddles once per packet
+    uint64_t start = time_us_64();
+    uint64_t end = start + (edges.empty() ? 0 : edges.back().time) + REPLAY_TAIL_US;
+    size_t next = 0;
+    while ((time_us_64() < end) || cwgen->is_busy()) {
+        uint64_t now = time_us_64();
+        while ((next < edges.size()) && (start + edges[next].time <= now)) {
+            host_set_time_us(start + edges[next].time);
+            host_gpio_set(edges[next].gpio, !edges[next].pressed);
+            next++;
+        }
+        host_set_time_us(now);
+        host_render_packet(cwgen, packet);
+        samples.insert(samples.end(), packet, packet + HOST_SAMPLE_BUFFER_SIZE);
+    }
+
+    std::vector<keyer_segment_t> segments = keyer_detect_segments(samples, 2 * HOST_SAMPLE_RATE / cwgen->get_frequency());
+    return keyer_segments_to_morse(segments, unit_samples(wpm));
+}
+
+int main(int argc, char **argv) {
+    uint16_t default_wpm = DEFAULT_WPM;
+    bool update = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "w:uh")) != -1) {
+        switch (opt) {
+            case 'w':
+                default_wpm = atoi(optarg);
+                break;
+            case 'u':
+                update = true;
+                break;
+            default:
+                fprintf(stderr, "usage: paddle_replay [-w wpm] [-u] capture...\n");
+                return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "usage: paddle_replay [-w wpm] [-u] capture...\n");
+        return 1;
+    }
+
+    CWGenerator *cwgen = new CWGenerator(HOST_SAMPLE_RATE, HOST_SAMPLE_BUFFER_SIZE);
+    int failed = 0;
+
+    for (int a = optind; a < argc; a++) {
+        std::vector<paddle_edge_t> edges;
+        uint16_t wpm = default_wpm;
+        if (!read_capture(argv[a], &edges, &wpm)) {
+            failed++;
+            continue;
+        }
+
+        std::string morse = replay(cwgen, edges, wpm);
+        std::string ref_path = std::string(argv[a]) + ".ref";
+        std::string reference;
+
+        if (update) {
+            FILE *f = fopen(ref_path.c_str(), "w");
+            if ((f == NULL) || (fprintf(f, "%s\n", morse.c_str()) < 0) || (fclose(f) != 0)) {
+                fprintf(stderr, "%s: cannot write\n", ref_path.c_str());
+                failed++;
+                continue;
+            }
+            printf("%s: %zu edges, %u WPM, reference updated: %s\n", argv[a], edges.size(), wpm, morse.c_str());
+        } else if (!read_reference(ref_path, &reference)) {
+            printf("%s: %zu edges, %u WPM, no reference: %s\n", argv[a], edges.size(), wpm, morse.c_str());
+        } else if (morse == reference) {
+            printf("%s: %zu edges, %u WPM, ok\n", argv[a], edges.size(), wpm);
+        } else {
+            size_t pos = 0;
+            while ((pos < morse.size()) && (pos < reference.size()) && (morse[pos] == reference[pos])) {
+                pos++;
+            }
+            size_t from = pos > 20 ? pos - 20 : 0;
+            printf("%s: %zu edges, %u WPM, MISMATCH at element %zu\n  expected: %s\n  got:      %s\n", argv[a], edges.size(), wpm, pos,
+                   reference.substr(from, 40).c_str(), morse.substr(from, 40).c_str());
+            failed++;
+        }
+    }
+
+    delete cwgen;
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,446 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * robustness and throughput harness for WinKeyerParser::parse_message(). Recorded WinKeyer sessions
+ * (.wkhex files, one line of hex bytes per write of the host) and generated command mixes are split
+ * into CDC reads at random boundaries. The calls the parser makes to the CWGenerator (recorded with
+ * cwgen_recorder) and the replies are compared against a reference model of the protocol that parses
+ * the complete stream at once. Calls and replies are compared as two separate streams since the
+ * replies of a read are returned after all of its commands were executed. The number of parsed bytes
+ * per second is reported as well.
+ *
+ * usage: parser_chunking [-r random_chunkings] [-g generated_mixes] [-s seed] [session.wkhex...]
+ */
+
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cwgen_recorder.h"
+#include "host_platform.h"
+#include "winkeyer_parser.h"
+
+#define CDC_BUFFER_SIZE 512                 // same as the firmware (picoditdah.cpp)
+#define CDC_READ_SIZE 64                    // maximum bytes per CDC read
+#define MIX_TOKENS 200                      // number of commands and characters per generated mix
+
+extern const char *WK123_CW_MAPPING[];      // defined in winkeyer_parser.cpp
+
+// frequencies of the sidetone command in WK1 / WK2 mode
+static const uint16_t MODEL_WK12_FREQUENCY[] = {0, 4000, 2000, 1333, 1000, 800, 666, 571, 500, 444, 400};
+
+// size of the admin commands including the leading 0x00 (WinKeyer3 datasheet and PicoDitDah extensions)
+static const uint8_t MODEL_ADMIN_SIZE[] = {3, 2, 2, 2, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 2, 2, 2, 4, 2, 2, 3, 2, 2, 3,
+                                           3, 3, 2, 3, 4, 2, 3, 4, 3, 3, 3, 3, 2, 4};
+
+static std::chrono::steady_clock::duration parse_time;
+static uint64_t parsed_bytes;
+
+static void add_event(std::vector<cwgen_event_t> *events, cwgen_event_type_t type, uint32_t value, const char *str) {
+    cwgen_event_t event = {type, value, str};
+    events->push_back(event);
+}
+
+/*
+ * reference model: parses the complete stream and returns the expected events
+ */
+static std::vector<cwgen_event_t> model_parse(const std::vector<uint8_t> &stream) {
+    std::vector<cwgen_event_t> events;
+    uint8_t version = 3;
+    uint16_t wpm = DEFAULT_WPM;
+
+    for (size_t i = 0; i < stream.size(); i++) {
+        uint8_t b = stream[i];
+        uint8_t p1 = i + 1 < stream.size() ? stream[i + 1] : 0;
+        uint8_t p2 = i + 2 < stream.size() ? stream[i + 2] : 0;
+
+        if ((b >= 0x61) && (b <= 0x7a)) {
+            b -= 0x20;
+        }
+        if ((b >= WinKeyerParser::cw_mapping_min_ascii) && (b <= WinKeyerParser::cw_mapping_max_ascii)) {
+            add_event(&events, EVENT_CHARACTER, 0, WK123_CW_MAPPING[b - WinKeyerParser::cw_mapping_min_ascii]);
+            continue;
+        }
+
+        switch (b) {
+            case 0x00:
+                switch (p1) {
+                    case 2:
+                        add_event(&events, EVENT_REPLY, 31, NULL);
+                        add_event(&events, EVENT_REPLY, 3, NULL);
+                        version = 1;
+                        break;
+                    case 4:
+                        add_event(&events, EVENT_REPLY, p2, NULL);
+                        break;
+                    case 5:
+                    case 6:
+                    case 7:
+                        add_event(&events, EVENT_REPLY, 0, NULL);
+                        break;
+                    case 9:
+                        add_event(&events, EVENT_REPLY, 31, NULL);
+                        break;
+                    case 10:
+                        version = 1;
+                        break;
+                    case 11:
+                        version = 2;
+                        break;
+                    case 20:
+                        version = 3;
+                        break;
+                    case 21:
+                        add_event(&events, EVENT_REPLY, 52, NULL);
+                        break;
+                    case 23:
+                        add_event(&events, EVENT_REPLY, 3, NULL);
+                        break;
+                    case 24:
+                        add_event(&events, EVENT_REPLY, 1, NULL);
+                        break;
+                    case 26:
+                        if ((p2 >= 1) && (p2 <= 50)) {
+                            add_event(&events, EVENT_RISETIME, p2, NULL);
+                        }
+                        break;
+                    case 27:
+                        add_event(&events, EVENT_FREQUENCY, p2 * 10, NULL);
+                        break;
+                    default:
+                        break;
+                }
+                i += (p1 < sizeof(MODEL_ADMIN_SIZE) ? MODEL_ADMIN_SIZE[p1] : 2) - 1;
+                break;
+            case 0x01:
+                if ((version < 3) && (p1 >= 1) && (p1 <= 0x0a)) {
+                    add_event(&events, EVENT_FREQUENCY, MODEL_WK12_FREQUENCY[p1], NULL);
+                } else if ((version == 3) && (p1 >= 15) && (p1 <= 125)) {
+                    add_event(&events, EVENT_FREQUENCY, 62500 / p1, NULL);
+                }
+                i++;
+                break;
+            case 0x02:
+                if ((p1 >= 5) && (p1 <= 99)) {
+                    add_event(&events, EVENT_WPM, p1, NULL);
+                    wpm = p1;
+                    i++;
+                }
+                break;
+            case 0x07:
+                add_event(&events, EVENT_REPLY, (wpm & 0x3F) | 0x80, NULL);
+                break;
+            case 0x09:
+                i++;
+                break;
+            case 0x0E:
+                version = 3;
+                break;
+            case 0x15:
+                add_event(&events, EVENT_REPLY, 0xC0, NULL);
+                break;
+            default:
+                break;
+        }
+    }
+    return events;
+}
+
+/*
+ * feeds the chunks through a new parser and returns the recorded events
+ */
+static std::vector<cwgen_event_t> parser_run(const std::vector<uint8_t> &stream, const std::vector<size_t> &chunks) {
+    CWGenerator cwgen(HOST_SAMPLE_RATE, HOST_SAMPLE_BUFFER_SIZE);
+    WinKeyerParser parser(&cwgen);
+    std::vector<cwgen_event_t> &events = cwgen_recorder_events();
+    size_t offset = 0;
+
+    events.clear();
+    for (size_t c = 0; c < chunks.size(); c++) {
+        uint8_t buf[CDC_BUFFER_SIZE];
+        memset(buf, 0xFF, sizeof(buf));
+        memcpy(buf, stream.data() + offset, chunks[c]);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        uint32_t count = parser.parse_message(buf, chunks[c], sizeof(buf));
+        parse_time += std::chrono::steady_clock::now() - start;
+        parsed_bytes += chunks[c];
+
+        for (uint32_t i = 0; i < count; i++) {
+            add_event(&events, EVENT_REPLY, buf[i], NULL);
+        }
+        offset += chunks[c];
+    }
+    return events;
+}
+
+static std::string describe(const cwgen_event_t &event) {
+    static const char *NAMES[] = {"character", "wpm", "frequency", "risetime", "volume", "reply"};
+    char buf[64];
+
+    if (event.type == EVENT_CHARACTER) {
+        snprintf(buf, sizeof(buf), "%s \"%s\"", NAMES[event.type], event.str);
+    } else {
+        snprintf(buf, sizeof(buf), "%s %u", NAMES[event.type], event.value);
+    }
+    return buf;
+}
+
+/*
+ * returns the replies or the generator calls of the events. The replies of a read are returned after all its
+ * commands were executed, so only the order within each of the two streams is defined
+ */
+static std::vector<cwgen_event_t> select_events(const std::vector<cwgen_event_t> &events, bool replies) {
+    std::vector<cwgen_event_t> selected;
+
+    for (size_t i = 0; i < events.size(); i++) {
+        if ((events[i].type == EVENT_REPLY) == replies) {
+            selected.push_back(events[i]);
+        }
+    }
+    return selected;
+}
+
+/*
+ * compares the events
+ * @return index of the first difference or -1 if equal
+ */
+static long compare(const std::vector<cwgen_event_t> &expected, const std::vector<cwgen_event_t> &actual) {
+    size_t n = expected.size() < actual.size() ? expected.size() : actual.size();
+
+    for (size_t i = 0; i < n; i++) {
+        bool same = (expected[i].type == actual[i].type) && (expected[i].value == actual[i].value);
+        if (same && (expected[i].type == EVENT_CHARACTER)) {
+            same = strcmp(expected[i].str, actual[i].str) == 0;
+        }
+        if (!same) {
+            return i;
+        }
+    }
+    return expected.size() == actual.size() ? -1 : (long)n;
+}
+
+/*
+ * runs a stream with the given chunking and reports the first difference to the model
+ * @return true if the events match the model
+ */
+static bool check(const char *name, const std::vector<uint8_t> &stream, const std::vector<size_t> &chunks,
+                  const std::vector<cwgen_event_t> &expected, bool verbose) {
+    std::vector<cwgen_event_t> actual = parser_run(stream, chunks);
+    bool same = true;
+
+    for (int replies = 0; replies < 2; replies++) {
+        std::vector<cwgen_event_t> expected_part = select_events(expected, replies);
+        std::vector<cwgen_event_t> actual_part = select_events(actual, replies);
+        long diff = compare(expected_part, actual_part);
+
+        if ((diff >= 0) && verbose) {
+            std::string chunking;
+            for (size_t c = 0; c < chunks.size() && c < 16; c++) {
+                chunking += (c ? "," : "") + std::to_string(chunks[c]);
+            }
+            fprintf(stderr, "%s: %s %ld: expected %s, got %s (chunks %s%s)\n", name, replies ? "reply" : "call", diff,
+                    (size_t)diff < expected_part.size() ? describe(expected_part[diff]).c_str() : "<end>",
+                    (size_t)diff < actual_part.size() ? describe(actual_part[diff]).c_str() : "<end>",
+                    chunking.c_str(), chunks.size() > 16 ? ",..." : "");
+        }
+        same = same && (diff < 0);
+    }
+    return same;
+}
+
+/*
+ * reads a .wkhex session: returns the stream and the recorded chunking (one chunk per line)
+ */
+static bool read_session(const char *path, std::vector<uint8_t> *stream, std::vector<size_t> *chunks) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return false;
+    }
+
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = 0;
+        }
+
+        size_t count = 0;
+        char *p = line;
+        unsigned int value;
+        int consumed;
+        while (sscanf(p, "%x%n", &value, &consumed) == 1) {
+            stream->push_back(value);
+            p += consumed;
+            count++;
+        }
+        // split long lines like the CDC reads of the device
+        while (count > 0) {
+            size_t n = count < CDC_READ_SIZE ? count : CDC_READ_SIZE;
+            chunks->push_back(n);
+            count -= n;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+/*
+ * generates a random mix of text and the commands supported by the parser
+ */
+static std::vector<uint8_t> generate_mix(std::mt19937 &rng) {
+    static const char TEXT[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 abcdefgh/?.,=+";
+    std::vector<uint8_t> stream;
+
+    for (int t = 0; t < MIX_TOKENS; t++) {
+        uint32_t r = rng() % 100;
+        if (r < 60) {
+            stream.push_back(TEXT[rng() % (sizeof(TEXT) - 1)]);
+        } else if (r < 65) {
+            stream.insert(stream.end(), {0x02, (uint8_t)(5 + rng() % 95)});                 // speed
+        } else if (r < 70) {
+            stream.insert(stream.end(), {0x01, (uint8_t)(15 + rng() % 111)});               // sidetone
+        } else if (r < 73) {
+            stream.push_back(0x07);                                                         // get speed pot
+        } else if (r < 76) {
+            stream.push_back(0x15);                                                         // status
+        } else if (r < 79) {
+            stream.insert(stream.end(), {0x00, 0x04, (uint8_t)(rng() % 256)});              // echo test
+        } else if (r < 82) {
+            static const uint8_t QUERIES[] = {0x05, 0x09, 0x15, 0x17, 0x18};
+            stream.insert(stream.end(), {0x00, QUERIES[rng() % sizeof(QUERIES)]});         // admin queries
+        } else if (r < 85) {
+            stream.insert(stream.end(), {0x00, 0x1A, (uint8_t)(1 + rng() % 50)});           // rise time
+        } else if (r < 88) {
+            stream.insert(stream.end(), {0x00, 0x1B, (uint8_t)(40 + rng() % 31)});          // frequency
+        } else if (r < 90) {
+            stream.insert(stream.end(), {0x00, (uint8_t)(rng() % 2 ? 0x14 : 0x0B)});        // WK3 / WK2 mode
+        } else if (r < 91) {
+            stream.push_back(0x0E);                                                         // WK3 mode
+        } else if (r < 92) {
+            stream.insert(stream.end(), {0x09, (uint8_t)(rng() % 2 ? 0x04 : 0x08)});        // pin configuration (radio 1 / 2)
+        } else {
+            static const uint8_t NOPS[] = {0x0A, 0x13, 0x1F};
+            stream.push_back(NOPS[rng() % sizeof(NOPS)]);                                   // commands without parameters
+        }
+    }
+    return stream;
+}
+
+/*
+ * random chunking with reads of 1 to CDC_READ_SIZE bytes
+ */
+static std::vector<size_t> random_chunks(size_t size, std::mt19937 &rng) {
+    std::vector<size_t> chunks;
+
+    while (size > 0) {
+        size_t n = 1 + rng() % CDC_READ_SIZE;
+        n = n < size ? n : size;
+        chunks.push_back(n);
+        size -= n;
+    }
+    return chunks;
+}
+
+int main(int argc, char **argv) {
+    int random_chunkings = 100;
+    int generated_mixes = 100;
+    uint32_t seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:g:s:h")) != -1) {
+        switch (opt) {
+            case 'r':
+                random_chunkings = atoi(optarg);
+                break;
+            case 'g':
+                generated_mixes = atoi(optarg);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: parser_chunking [-r random_chunkings] [-g generated_mixes] [-s seed] [session.wkhex...]\n");
+                return 1;
+        }
+    }
+
+    std::mt19937 rng(seed);
+    int total_failed = 0;
+
+    for (int a = optind; a < argc; a++) {
+        std::vector<uint8_t> stream;
+        std::vector<size_t> recorded;
+        if (!read_session(argv[a], &stream, &recorded)) {
+            fprintf(stderr, "%s: cannot read\n", argv[a]);
+            return 1;
+        }
+
+        std::vector<cwgen_event_t> expected = model_parse(stream);
+        int failed = check(argv[a], stream, recorded, expected, true) ? 0 : 1;
+        printf("%s recorded: runs=1 failed=%d\n", argv[a], failed);
+        total_failed += failed;
+
+        failed = 0;
+        for (int r = 0; r < random_chunkings; r++) {
+            failed += check(argv[a], stream, random_chunks(stream.size(), rng), expected, failed == 0) ? 0 : 1;
+        }
+        printf("%s random: runs=%d failed=%d\n", argv[a], random_chunkings, failed);
+        total_failed += failed;
+    }
+
+    int failed_fixed = 0;
+    int failed_random = 0;
+    for (int g = 0; g < generated_mixes; g++) {
+        std::vector<uint8_t> stream = generate_mix(rng);
+        std::vector<cwgen_event_t> expected = model_parse(stream);
+
+        // one command per read, as most hosts send them
+        std::vector<size_t> per_token;
+        for (size_t i = 0; i < stream.size(); i++) {
+            size_t n = stream[i] == 0x00 ? MODEL_ADMIN_SIZE[stream[i + 1]] : ((stream[i] == 0x01) || (stream[i] == 0x02) || (stream[i] == 0x09) ? 2 : 1);
+            per_token.push_back(n);
+            i += n - 1;
+        }
+        failed_fixed += check("mix per command", stream, per_token, expected, failed_fixed == 0) ? 0 : 1;
+        failed_random += check("mix random", stream, random_chunks(stream.size(), rng), expected, failed_random == 0) ? 0 : 1;
+    }
+    if (generated_mixes > 0) {
+        printf("generated per command: runs=%d failed=%d\n", generated_mixes, failed_fixed);
+        printf("generated random: runs=%d failed=%d\n", generated_mixes, failed_random);
+    }
+    total_failed += failed_fixed + failed_random;
+
+    double seconds = std::chrono::duration<double>(parse_time).count();
+    printf("throughput: %llu bytes, %.1f bytes/s, %.1f ns/byte\n", (unsigned long long)parsed_bytes,
+           seconds > 0 ? parsed_bytes / seconds : 0, parsed_bytes > 0 ? seconds * 1e9 / parsed_bytes : 0);
+
+    return total_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,292 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * device simulator: runs the WinKeyerParser and the CWGenerator of the firmware and presents the
+ * WinKeyer protocol on a pseudo terminal. The rendered audio is streamed in real time as raw PCM
+ * (signed 16 bit little endian, mono, 48 kHz) to stdout or a file/FIFO. The paddles can be scripted.
+ *
+ * usage: wk_sim [-a audio] [-l link] [-p paddle_script] [-x] [-n]
+ *   -a audio: output of the raw PCM stream (default "-" for stdout, e.g. a FIFO created by mkfifo)
+ *   -l link: create a symlink to the pseudo terminal (e.g. /tmp/winkeyer)
+ *   -p paddle_script: file with lines "<time in ms> <dit|dah> <down|up>" (# starts a comment)
+ *   -x: exit when the paddle script is finished and the keyer is idle
+ *   -n: do not pace the simulation in real time (run as fast as possible)
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "cw_generator.h"
+#include "host_render.h"
+#include "winkeyer_parser.h"
+
+#define CDC_BUFFER_SIZE 512                 // same as the firmware (picoditdah.cpp)
+#define CDC_READ_SIZE 64                    // maximum bytes per CDC read
+#define PACKET_PERIOD_NS 1000000            // one USB packet per ms
+
+// scripted paddle event
+typedef struct {
+    uint64_t time_us;
+    uint gpio;
+    bool level;
+} paddle_event_t;
+
+static CWGenerator *sim_cwgen;
+static int audio_fd = -1;
+static bool realtime = true;
+static struct timespec next_tick;
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int signum) {
+    (void)signum;
+    stop = 1;
+}
+
+/*
+ * writes all bytes to a file descriptor
+ * @return false if the reader went away
+ */
+static bool write_all(int fd, const void *data, size_t size) {
+    const uint8_t *p = (const uint8_t *)data;
+
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+/*
+ * waits for the next packet period and renders one packet
+ */
+static void sim_tick() {
+    int16_t samples[HOST_SAMPLE_BUFFER_SIZE];
+
+    if (realtime) {
+        next_tick.tv_nsec += PACKET_PERIOD_NS;
+        if (next_tick.tv_nsec >= 1000000000) {
+            next_tick.tv_nsec -= 1000000000;
+            next_tick.tv_sec++;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_tick, NULL) == EINTR && !stop) {}
+    }
+
+    host_render_packet(sim_cwgen, samples);
+    if ((audio_fd >= 0) && !write_all(audio_fd, samples, sizeof(samples))) {
+        fprintf(stderr, "wk_sim: audio reader closed the stream\n");
+        stop = 1;
+    }
+}
+
+/*
+ * reads the paddle script
+ * @return false on error
+ */
+static bool read_script(const char *path, std::vector<paddle_event_t> *events) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return false;
+    }
+
+    char line[128];
+    int nr = 0;
+    while (fgets(line, sizeof(line), f)) {
+        nr++;
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = 0;
+        }
+
+        double time_ms;
+        char paddle[8], state[8];
+        int fields = sscanf(line, "%lf %7s %7s", &time_ms, paddle, state);
+        if (fields <= 0) {
+            continue;
+        }
+        if ((fields != 3) || (strcmp(paddle, "dit") && strcmp(paddle, "dah")) || (strcmp(state, "down") && strcmp(state, "up"))) {
+            fprintf(stderr, "%s:%d: expected \"<time in ms> <dit|dah> <down|up>\"\n", path, nr);
+            fclose(f);
+            return false;
+        }
+
+        paddle_event_t event;
+        event.time_us = (uint64_t)(time_ms * 1000);
+        event.gpio = strcmp(paddle, "dit") == 0 ? DIT_GPIO : DAH_GPIO;
+        event.level = strcmp(state, "up") == 0;             // paddles are active low
+        events->push_back(event);
+    }
+
+    fclose(f);
+    return true;
+}
+
+/*
+ * opens the master side of a pseudo terminal in raw mode
+ * @param slave_fd: receives an open descriptor of the slave side, which keeps the master readable
+ * @return master descriptor or -1
+ */
+static int open_pty(int *slave_fd) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((master < 0) || (grantpt(master) != 0) || (unlockpt(master) != 0)) {
+        return -1;
+    }
+
+    *slave_fd = open(ptsname(master), O_RDWR | O_NOCTTY);
+    if (*slave_fd < 0) {
+        return -1;
+    }
+
+    struct termios tio;
+    tcgetattr(*slave_fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(*slave_fd, TCSANOW, &tio);
+
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+    return master;
+}
+
+int main(int argc, char **argv) {
+    const char *audio_path = "-";
+    const char *link_path = NULL;
+    const char *script_path = NULL;
+    bool exit_when_done = false;
+    std::vector<paddle_event_t> events;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "a:l:p:xnh")) != -1) {
+        switch (opt) {
+            case 'a':
+                audio_path = optarg;
+                break;
+            case 'l':
+                link_path = optarg;
+                break;
+            case 'p':
+                script_path = optarg;
+                break;
+            case 'x':
+                exit_when_done = true;
+                break;
+            case 'n':
+                realtime = false;
+                break;
+            default:
+                fprintf(stderr, "usage: wk_sim [-a audio] [-l link] [-p paddle_script] [-x] [-n]\n");
+                return 1;
+        }
+    }
+
+    if (script_path && !read_script(script_path, &events)) {
+        fprintf(stderr, "wk_sim: cannot read paddle script %s\n", script_path);
+        return 1;
+    }
+
+    // the firmware prints debug messages to stdout, keep them out of the audio stream
+    if (strcmp(audio_path, "-") == 0) {
+        audio_fd = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    } else {
+        fprintf(stderr, "wk_sim: waiting for a reader of %s\n", audio_path);
+        audio_fd = open(audio_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (audio_fd < 0) {
+            fprintf(stderr, "wk_sim: cannot open %s: %s\n", audio_path, strerror(errno));
+            return 1;
+        }
+    }
+
+    int slave_fd;
+    int pty = open_pty(&slave_fd);
+    if (pty < 0) {
+        fprintf(stderr, "wk_sim: cannot open pseudo terminal: %s\n", strerror(errno));
+        return 1;
+    }
+    if (link_path) {
+        unlink(link_path);
+        if (symlink(ptsname(pty), link_path) != 0) {
+            fprintf(stderr, "wk_sim: cannot create %s: %s\n", link_path, strerror(errno));
+        }
+    }
+    fprintf(stderr, "wk_sim: WinKeyer on %s\n", link_path ? link_path : ptsname(pty));
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    sim_cwgen = new CWGenerator(HOST_SAMPLE_RATE, HOST_SAMPLE_BUFFER_SIZE);
+    WinKeyerParser parser(sim_cwgen);
+
+    // as on the device, a full character queue blocks the parser until the audio consumed characters
+    host_set_queue_block_handler(sim_tick);
+    clock_gettime(CLOCK_MONOTONIC, &next_tick);
+
+    size_t next_event = 0;
+    while (!stop) {
+        while ((next_event < events.size()) && (events[next_event].time_us <= time_us_64())) {
+            host_gpio_set(events[next_event].gpio, events[next_event].level);
+            next_event++;
+        }
+
+        uint8_t buf[CDC_BUFFER_SIZE];
+        ssize_t count = read(pty, buf, CDC_READ_SIZE);
+        if (count > 0) {
+            count = parser.parse_message(buf, count, sizeof(buf));
+            if ((count > 0) && !write_all(pty, buf, count)) {
+                fprintf(stderr, "wk_sim: cannot write to pseudo terminal\n");
+            }
+        }
+
+        sim_tick();
+
+        if (exit_when_done && (next_event == events.size()) && !sim_cwgen->is_busy() && (count <= 0)) {
+            break;
+        }
+    }
+
+    if (link_path) {
+        unlink(link_path);
+    }
+    host_set_queue_block_handler(NULL);
+    delete sim_cwgen;
+    close(slave_fd);
+    close(pty);
+    close(audio_fd);
+    return 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "boot_stats.h"
+
+/*
+ * startup milestones, each entry is written once by one core
+ */
+
+static const char *event_names[BOOT_EVENTS] = {"main", "usb connected", "loop", "keyer ready", "enumerated",
+                                               "stream open", "first packet"};
+
+static volatile uint32_t event_us[BOOT_EVENTS];     // time of the milestone since the timer started
+static volatile bool event_marked[BOOT_EVENTS];     // milestone was reached
+
+/*
+ * records the time of a milestone if it was not reached before
+ * @param event: milestone
+ */
+void __not_in_flash_func(boot_stats_mark)(boot_event_t event) {
+    if (event_marked[event]) {
+        return;
+    }
+    event_us[event] = time_us_32();
+    event_marked[event] = true;
+}
+
+/*
+ * writes a human readable report of the milestones
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t boot_stats_report(char *buf, uint32_t maxsize) {
+    uint32_t len = snprintf(buf, maxsize, "boot milestone time [us]\n");
+
+    for (uint32_t i = 0; (i < BOOT_EVENTS) && (len < maxsize); i++) {
+        if (event_marked[i]) {
+            len += snprintf(buf + len, maxsize - len, "%s %lu\n", event_names[i], (unsigned long)event_us[i]);
+        } else {
+            len += snprintf(buf + len, maxsize - len, "%s -\n", event_names[i]);
+        }
+    }
+
+    return len < maxsize ? len : maxsize - 1;
+}
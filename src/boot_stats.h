@@ -0,0 +1,67 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef _BOOT_STATS_H_
+#define _BOOT_STATS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "pico/stdlib.h"
+
+/*
+ * records the time of the milestones of the startup: USB connected, enumerated by the host, keyer core ready
+ * and first audio packet. Only the first occurrence of each milestone is kept, so a re-enumeration after a bus
+ * reset does not overwrite the startup times. Times are taken from the microsecond timer, which is started by
+ * the runtime initialization before main(). The boot ROM and the flash second stage (a few ms) are not included.
+ */
+
+typedef enum {
+    BOOT_MAIN,                              // main() entered
+    BOOT_USB_CONNECTED,                     // USB stack initialized, the pull-up signals the device to the host
+    BOOT_LOOP,                              // core 0 entered the scheduler loop, USB events are serviced
+    BOOT_KEYER_READY,                       // keyshape table and LED initialized on core 1, rendering may start
+    BOOT_ENUMERATED,                        // configuration set by the host
+    BOOT_STREAM_OPEN,                       // the host started the microphone stream
+    BOOT_FIRST_PACKET,                      // first packet rendered by the keyer passed to the USB stack
+    BOOT_EVENTS
+} boot_event_t;
+
+/*
+ * records the time of a milestone if it was not reached before (both cores, also from interrupts)
+ * @param event: milestone
+ */
+void boot_stats_mark(boot_event_t event);
+
+/*
+ * writes a human readable report of the time of each milestone since the timer started, milestones not
+ * reached yet are shown as "-"
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t boot_stats_report(char *buf, uint32_t maxsize);
+
+#endif
@@ -27,6 +27,12 @@
 
 #include "../button-debouncer/button_debounce.h"
 #include "hardware/clocks.h"
+#include "hardware/sync.h"
+#include "latency_stats.h"
+#include "led_service.h"
+#include "mem_stats.h"
+#include "paddle_capture.h"
+#include "power_manager.h"
 #include "ws2812.pio.h"
 
 /*
@@ -46,13 +52,65 @@
     #define WS2812_POWER_PIN PICO_DEFAULT_WS2812_POWER_PIN
 #else
     // default to pin 1 if the board doesn't have a default WS2812 power pin defined
-    #define WS2821_POWER_PIN 1
+    #define WS2812_POWER_PIN 1
 #endif
 
+#define WS2812_FREQ 800000                  // bit rate of the Neopixel LED
 #define WS2812_COLOR_PADDLE ((uint32_t) (255) << 8) | ((uint32_t) (255) << 16) | (uint32_t) (255)           // r << 8 | g << 16 | b
 #define WS2812_COLOR_SERIAL ((uint32_t) (0) << 8) | ((uint32_t) (255) << 16) | (uint32_t) (0)
 #define WS2812_COLOR_OFF ((uint32_t) (0) << 8) | ((uint32_t) (0) << 16) | (uint32_t) (0)
 
+#ifdef CW_RENDER_TONE
+// implementation of cw_render_tone() selected by the build (e.g. the vectorized host backend)
+void CW_RENDER_TONE(const cw_tone_params_t *params, int16_t *out, uint32_t count);
+#else
+#define CW_RENDER_TONE cw_render_tone
+#endif
+
+/*
+ * keyshape table shared by the generators using the same envelope at the same sample rate
+ */
+typedef struct {
+    float *table;                           // key shape factors, NULL: entry unused
+    uint32_t size;                          // number of factors (maximum rise time)
+    CWGenerator::CW_ENVELOPE envelope;      // envelope of the table
+    uint32_t users;                         // number of generators using the table
+} keyshape_table_t;
+
+static keyshape_table_t keyshape_tables[KEYSHAPE_TABLES_MAX];
+static bool paddles_initialized = false;    // paddle GPIOs, debouncer and interrupt are set up
+
+Debounce CWGenerator::debouncer;
+PIO CWGenerator::ws2812_pio;
+volatile int CWGenerator::ws2812_sm = -1;
+
+/*
+ * GPIO interrupt handler of the paddles. Raises the system clock before the element starts and passes the raw
+ * edges to the latency measurement and the paddle capture
+ */
+static void __not_in_flash_func(paddle_gpio_callback)(uint gpio, uint32_t events) {
+    power_manager_activity();
+    latency_stats_edge(gpio, events);
+    paddle_capture_edge(gpio, events);
+}
+
+/*
+ * initializes a queue on storage provided by the caller. queue_init() of pico_util allocates the storage on the heap
+ * and cannot be given a buffer, the fields are set up the same way
+ * @param q: queue to initialize
+ * @param storage: (element_count + 1) * element_size bytes
+ * @param element_size: size of an element in bytes
+ * @param element_count: maximum number of elements in the queue
+ */
+static void queue_init_storage(queue_t *q, uint8_t *storage, uint element_size, uint element_count) {
+    lock_init(&q->core, next_striped_spin_lock_num());
+    q->data = storage;
+    q->element_count = (uint16_t)element_count;
+    q->element_size = (uint16_t)element_size;
+    q->wptr = 0;
+    q->rptr = 0;
+}
+
 /*
  * constructor for the morse code sound generator with default frequency and speed
  * @param sample_rate: sample rate of the audio signal
@@ -70,61 +128,230 @@ CWGenerator::CWGenerator(uint32_t sample_rate, uint32_t sample_buffer_size) : CW
  * @param risetime: rise time of the Blackman window
  */
 CWGenerator::CWGenerator(uint32_t sample_rate, uint32_t sample_buffer_size, uint16_t freq, uint16_t wpm, uint16_t volume, float risetime) {
-    curstate = STATE_INIT;
+    uint32_t signal_buffer_maxsize = ceil(sample_rate / (float)(audio_minfreq));
+
+    output_buffer = (int16_t *)malloc(sizeof(int16_t) * (sample_buffer_size + 1));
+    signal_buffer = (float *)malloc(sizeof(float) * signal_buffer_maxsize);
+
+    mem_stats_account("cwgen output_buffer", sizeof(int16_t) * (sample_buffer_size + 1));
+    mem_stats_account("cwgen signal_buffer", sizeof(float) * signal_buffer_maxsize);
+
+    init_generator(sample_rate, sample_buffer_size, freq, wpm, volume, risetime, NULL, false);
+}
+
+/*
+ * constructor for derived classes providing the buffers (see CWGeneratorFixed)
+ * @param sample_rate: sample rate of the audio signal
+ * @param sample_buffer_size: size of the buffer used to transmit the audio signal
+ * @param output: output buffer of sample_buffer_size + 1 samples
+ * @param signal: buffer for one period of the lowest frequency
+ * @param queue: storage of the character queue, (queue_max_char + 1) * sizeof(CW_CHARACTERS) bytes
+ * @param defer: true to leave the keyshape table and the Neopixel LED to init_deferred()
+ */
+CWGenerator::CWGenerator(uint32_t sample_rate, uint32_t sample_buffer_size, int16_t *output, float *signal, uint8_t *queue, bool defer) {
+    output_buffer = output;
+    signal_buffer = signal;
+
+    init_generator(sample_rate, sample_buffer_size, DEFAULT_FREQUENCY, DEFAULT_WPM, DEFAULT_VOLUME, DEFAULT_RISETIME, queue, defer);
+}
+
+/*
+ * leaves the shared keyshape table, the table is freed if no other generator uses it
+ */
+CWGenerator::~CWGenerator() {
+    release_keyshape();
+}
+
+/*
+ * initializes the generator and the paddles. The buffers must be set
+ * @param sample_rate: sample rate of the audio signal
+ * @param sample_buffer_size: size of the buffer used to transmit the audio signal
+ * @param freq: frequency of the audio signal
+ * @param wpm: speed of the morse code in WPM (Words Per Minute)
+ * @param volume: volume of the signal [0:100]
+ * @param risetime: rise time of the Blackman window
+ * @param queue: storage of the character queue, NULL to allocate it on the heap
+ * @param defer: true to leave the keyshape table and the Neopixel LED to init_deferred()
+ */
+void CWGenerator::init_generator(uint32_t sample_rate, uint32_t sample_buffer_size, uint16_t freq, uint16_t wpm, uint16_t volume, float risetime,
+                                 uint8_t *queue, bool defer) {
+    curstate = STATE_IDLE;
+    nextstate = STATE_IDLE;
     cw_sample_rate = sample_rate;
     cw_sample_buffer_size = sample_buffer_size;
     cw_frequency = freq;
     cw_wpm = wpm;
     cw_volume = volume * MAX_VOLUME / 100;
     cw_risetime = risetime;
+    cw_risetime_samples_maxsize = ceil(RISETIME_MAX * cw_sample_rate / 1000);
+    param_forwarder = NULL;
+    paddles_enabled = true;
+    key_gpio = -1;
 
-    // signal_buffer = NULL;
-    // output_buffer = NULL;
-    // cw_keyshape = NULL;
-
-    output_buffer = (int16_t *)malloc(sizeof(int16_t) * (cw_sample_buffer_size + 1));
-
-    uint32_t signal_buffer_maxsize = ceil(cw_sample_rate / (float)(audio_minfreq));
-    signal_buffer = (float *)malloc(sizeof(float) * signal_buffer_maxsize);
+    cw_envelope = ENVELOPE_BLACKMAN_HARRIS;
+    cw_keyshape = NULL;
 
-    cw_risetime_samples_maxsize = ceil(RISETIME_MAX * cw_sample_rate / 1000);
-    cw_keyshape = (float *)malloc(sizeof(float) * cw_risetime_samples_maxsize);
+    init_buffers();
 
-    // generate signal shaping based on Blackman-Harris: https://en.wikipedia.org/wiki/Window_function#Blackman%E2%80%93Harris_window
-    // we only use the first half (rise)
-    std::fill_n(cw_keyshape, cw_risetime_samples_maxsize, 1);
-    for (int i = 0; i < cw_risetime_samples_maxsize; i++) {
-        //cw_keyshape[i] = (0.42 - 0.50 * cos(M_PI * i / cw_risetime_samples_maxsize) + 0.08 * cos(2 * M_PI * i / cw_risetime_samples_maxsize));
-        cw_keyshape[i] = 0.35875-0.48829*cos(M_PI * i / cw_risetime_samples_maxsize) + 0.14128*cos(2 * M_PI * i / cw_risetime_samples_maxsize) - 0.01168*cos(4 * M_PI * i / cw_risetime_samples_maxsize);
+    // initialize GPIO for paddle, once for all generators
+    if (!paddles_initialized) {
+        gpio_init(DIT_GPIO);
+        gpio_init(DAH_GPIO);
+        gpio_set_dir(DIT_GPIO, false);
+        gpio_set_dir(DAH_GPIO, false);
+        gpio_pull_up(DIT_GPIO);
+        gpio_pull_up(DAH_GPIO);
+        debouncer.debounce_gpio(DIT_GPIO);
+        debouncer.set_debounce_time(DIT_GPIO, 0.5);
+        debouncer.debounce_gpio(DAH_GPIO);
+        debouncer.set_debounce_time(DAH_GPIO, 0.5);
+        paddle_capture_init(DIT_GPIO, DAH_GPIO);
+        gpio_set_irq_enabled_with_callback(DIT_GPIO, GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE, true, &paddle_gpio_callback);
+        gpio_set_irq_enabled(DAH_GPIO, GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE, true);
+        paddles_initialized = true;
     }
+    latency_pending = false;
 
-    init_buffers();
+    if (queue != NULL) {
+        queue_init_storage(&cw_character_queue, queue, sizeof(CW_CHARACTERS), queue_max_char);
+    } else {
+        queue_init(&cw_character_queue, sizeof(CW_CHARACTERS), queue_max_char);
+        mem_stats_account("cwgen queue", sizeof(CW_CHARACTERS) * (queue_max_char + 1));
+    }
 
-    // initialize GPIO for paddle
-    gpio_init(DIT_GPIO);
-    gpio_init(DAH_GPIO);
-    gpio_set_dir(DIT_GPIO, false);
-    gpio_set_dir(DAH_GPIO, false);
-    gpio_pull_up(DIT_GPIO);
-    gpio_pull_up(DAH_GPIO);
-    debouncer.debounce_gpio(DIT_GPIO);
-    debouncer.set_debounce_time(DIT_GPIO, 0.5);
-    debouncer.debounce_gpio(DAH_GPIO);
-    debouncer.set_debounce_time(DAH_GPIO, 0.5);
+    if (!defer) {
+        init_deferred();
+    }
+}
 
+/*
+ * generates the keyshape table and initializes the PIO and DMA channel of the Neopixel LED (once for all generators)
+ */
+void CWGenerator::init_deferred() {
+    init_keyshape(cw_envelope);     // without a table the generator stays silent
+    if (ws2812_sm >= 0) {
+        return;                     // LED already initialized by another generator
+    }
 
     // initialize PIO used for Neopixel LED
     ws2812_pio = pio1;              // use PIO1 as default (PIO0 is used for button debouncer)
-    ws2812_sm = pio_claim_unused_sm(ws2812_pio, true);
+    int sm = pio_claim_unused_sm(ws2812_pio, true);
     uint offset = pio_add_program(ws2812_pio, &ws2812_program);
     gpio_init(WS2812_POWER_PIN);
     gpio_set_dir(WS2812_POWER_PIN, true);
     gpio_put(WS2812_POWER_PIN, true);                                                       // enable Neopixel LED
 
-    ws2812_program_init(ws2812_pio, ws2812_sm, offset, WS2812_PIN, 800000, IS_RGBW);
+    ws2812_program_init(ws2812_pio, sm, offset, WS2812_PIN, WS2812_FREQ, IS_RGBW);
+    led_service_init(ws2812_pio, sm);
     put_pixel(WS2812_COLOR_OFF);
+    ws2812_sm = sm;                 // the clock dividers of the LED are updated from now on
+}
+
+/*
+ * generates a keyshape table, we only use the first half (rise) of the window
+ * @param table: buffer of size factors
+ * @param size: number of factors (maximum rise time)
+ * @param envelope: envelope shape
+ */
+static void build_keyshape(float *table, uint32_t size, CWGenerator::CW_ENVELOPE envelope) {
+    std::fill_n(table, size, 1);
+    for (uint32_t i = 0; i < size; i++) {
+        float x = M_PI * i / size;
+        switch (envelope) {
+            case CWGenerator::ENVELOPE_BLACKMAN:
+                table[i] = (0.42 - 0.50 * cos(x) + 0.08 * cos(2 * x));
+                break;
+            case CWGenerator::ENVELOPE_RAISED_COSINE:
+                table[i] = 0.5 - 0.5 * cos(x);
+                break;
+            case CWGenerator::ENVELOPE_LINEAR:
+                table[i] = (float)i / size;
+                break;
+            default:
+                // signal shaping based on Blackman-Harris: https://en.wikipedia.org/wiki/Window_function#Blackman%E2%80%93Harris_window
+                table[i] = 0.35875-0.48829*cos(M_PI * i / size) + 0.14128*cos(2 * M_PI * i / size) - 0.01168*cos(4 * M_PI * i / size);
+                break;
+        }
+    }
+}
 
-    queue_init(&cw_character_queue, sizeof(CW_CHARACTERS), queue_max_char);
+/*
+ * returns the shared keyshape table of an envelope
+ * @param size: number of factors (maximum rise time)
+ * @param envelope: envelope shape
+ * @return table entry, NULL if no generator uses the envelope at this size
+ */
+static keyshape_table_t *find_keyshape(uint32_t size, CWGenerator::CW_ENVELOPE envelope) {
+    for (uint32_t i = 0; i < KEYSHAPE_TABLES_MAX; i++) {
+        keyshape_table_t *entry = &keyshape_tables[i];
+        if ((entry->table != NULL) && (entry->size == size) && (entry->envelope == envelope)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * selects the shared keyshape table of an envelope, generates it if no other generator uses it. On failure the
+ * previous table is kept
+ * @param envelope: envelope shape
+ * @return false if no table entry is free or the table could not be allocated
+ */
+bool CWGenerator::init_keyshape(CW_ENVELOPE envelope) {
+    keyshape_table_t *entry = find_keyshape(cw_risetime_samples_maxsize, envelope);
+
+    if ((entry != NULL) && (entry->table == cw_keyshape)) {
+        return true;                // table already in use by this generator
+    }
+
+    if (entry == NULL) {
+        for (uint32_t i = 0; (i < KEYSHAPE_TABLES_MAX) && (entry == NULL); i++) {
+            if (keyshape_tables[i].table == NULL) {
+                entry = &keyshape_tables[i];
+            }
+        }
+        if (entry == NULL) {
+            printf("ERROR: too many keyshape tables\n");
+            return false;
+        }
+
+        float *table = (float *)malloc(sizeof(float) * cw_risetime_samples_maxsize);
+        if (table == NULL) {
+            printf("ERROR: no memory for the keyshape table\n");
+            return false;
+        }
+        mem_stats_account("cwgen keyshape shared", sizeof(float) * cw_risetime_samples_maxsize);
+        build_keyshape(table, cw_risetime_samples_maxsize, envelope);
+
+        entry->size = cw_risetime_samples_maxsize;
+        entry->envelope = envelope;
+        entry->users = 0;
+        entry->table = table;
+    }
+
+    entry->users++;
+    release_keyshape();
+    cw_keyshape = entry->table;
+    return true;
+}
+
+/*
+ * leaves the shared keyshape table, the table is freed if no other generator uses it
+ */
+void CWGenerator::release_keyshape() {
+    for (uint32_t i = 0; i < KEYSHAPE_TABLES_MAX; i++) {
+        keyshape_table_t *entry = &keyshape_tables[i];
+        if ((entry->table == NULL) || (entry->table != cw_keyshape)) {
+            continue;
+        }
+
+        entry->users--;
+        if (entry->users == 0) {
+            free(entry->table);
+            entry->table = NULL;
+        }
+    }
+    cw_keyshape = NULL;
 }
 
 /*
@@ -136,21 +363,10 @@ void CWGenerator::init_buffers() {
     cw_frequency = cw_frequency > audio_maxfreq ? audio_maxfreq : cw_frequency;
     cw_frequency = cw_frequency < audio_minfreq ? audio_minfreq : cw_frequency;
 
-    // calculate the audio buffer size, the start of the pause buffer and allocate the memory
-    signal_buffer_period = ceil(cw_sample_rate / (float)(cw_frequency));
-    signal_dit_length_index = (60 / (50 * (float)(cw_wpm))) * cw_sample_rate;                                               // length of DIT t_dit = 60 / (50 * wpm). Source: https://morsecode.world/international/timing.html
-    signal_dit_length_index = ceil((float)(signal_dit_length_index) / signal_buffer_period) * signal_buffer_period;         // must be a whole multiple of the tone period to ensure tone ends after a full period
-
-
-    // calculate nr. of samples for envelope shaping
-    cw_risetime_samples = ceil(cw_risetime * cw_sample_rate / 1000);
-    //cw_risetime_samples = ceil((float)(cw_risetime * cw_sample_rate / 1000) / signal_buffer_period) * signal_buffer_period;
-    cw_risetime_samples = cw_risetime_samples > signal_dit_length_index/2 ? signal_dit_length_index/2 : cw_risetime_samples;
-
-    // calculate step size for envelope shaping
-    cw_keyshape_stepsize = ceil(cw_risetime_samples_maxsize / cw_risetime_samples);
+    // calculate the tone period, the DIT length and the rise time in samples
+    update_timing();
 
-    for (int i = 0; i < signal_buffer_period; i++) {                                                                        // generate a single sine wave
+    for (uint32_t i = 0; i < signal_buffer_period; i++) {                                                                    // generate a single sine wave
         signal_buffer[i] = cw_volume * sin(i * 2.0 * M_PI * 1 / (float)(signal_buffer_period));                             // use rounded value of cw_sample_rate / cw_frequency, to avoid distortion in audio signal
     }
 
@@ -158,6 +374,14 @@ void CWGenerator::init_buffers() {
     inchar_index = 0;
 }
 
+/*
+ * computes the tone period, the DIT length and the rise time in samples for the sample rate set at runtime. During
+ * construction this version is used by derived classes as well, it gives the same result
+ */
+void CWGenerator::update_timing() {
+    compute_timing(cw_sample_rate);
+}
+
 /*
  * Initializes the Butterworth low pass filter based on book Recursive Digital Filters: A Concise Guide (https://abrazol.com/books/filter1/)
  */
@@ -172,11 +396,13 @@ void CWGenerator::clear_queue() {
 }
 
 /*
- * set the integrated Neopixel to the specified color
+ * set the integrated Neopixel to the specified color. Only changes are sent to the LED, without blocking
  * @param pixel_grb: color of the Neopixel LED (r << 8 | g << 16 | b)
  */
 inline void CWGenerator::put_pixel(uint32_t pixel_grb) {
-    pio_sm_put_blocking(ws2812_pio, ws2812_sm, pixel_grb << 8u);
+    if (paddles_enabled) {
+        led_service_set(pixel_grb);     // the LED shows the generator keyed by the paddles
+    }
 }
 
 /*
@@ -185,6 +411,9 @@ inline void CWGenerator::put_pixel(uint32_t pixel_grb) {
  *              the value must be between [audio_minfreq, audio_maxfreq]
  */
 void CWGenerator::set_frequency(uint16_t freq) {
+    if (forward_param(PARAM_FREQUENCY, freq)) {
+        return;
+    }
     cw_frequency = freq;
     init_buffers();
 }
@@ -202,6 +431,9 @@ uint16_t CWGenerator::get_frequency() {
  * @param wpm: the speed in WPM
  */
 void CWGenerator::set_wpm(uint16_t wpm) {
+    if (forward_param(PARAM_WPM, wpm)) {
+        return;
+    }
     cw_wpm = wpm < WPM_MIN ? WPM_MIN : wpm;
     cw_wpm = wpm > WPM_MAX ? WPM_MAX : cw_wpm;
     init_buffers();
@@ -220,6 +452,9 @@ uint16_t CWGenerator::get_wpm() {
  * @param wpm: rise time in ms
  */
 void CWGenerator::set_risetime(float risetime) {
+    if (forward_param(PARAM_RISETIME, (uint32_t)(risetime * 100 + 0.5f))) {
+        return;
+    }
     cw_risetime = risetime < RISETIME_MIN ? RISETIME_MIN : risetime;
     cw_risetime = risetime > RISETIME_MAX ? RISETIME_MAX : risetime;
     init_buffers();
@@ -233,11 +468,35 @@ float CWGenerator::get_risetime() {
     return cw_risetime;
 }
 
+/*
+ * set the envelope shape of the rising and falling edges
+ * @param envelope: envelope shape
+ */
+void CWGenerator::set_envelope(CW_ENVELOPE envelope) {
+    if (forward_param(PARAM_ENVELOPE, envelope)) {
+        return;
+    }
+    if (init_keyshape(envelope)) {
+        cw_envelope = envelope;     // otherwise the previous envelope and its table are kept
+    }
+}
+
+/*
+ * get the envelope shape of the rising and falling edges
+ * @return envelope shape
+ */
+CWGenerator::CW_ENVELOPE CWGenerator::get_envelope() {
+    return cw_envelope;
+}
+
 /*
  * set the volume of the morse signal [0:100]
  * @param volume: volume [%] of the morse signal
  */
 void CWGenerator::set_volume(uint16_t vol) {
+    if (forward_param(PARAM_VOLUME, vol)) {
+        return;
+    }
     if (vol * 32767 / 100 != cw_volume) {
         cw_volume = vol * MAX_VOLUME / 100;
 
@@ -271,7 +530,7 @@ void CWGenerator::send_character(char *ch) {
     CW_CHARACTERS cwchar;
     CW_CHARACTERS cwchar_pause = CHAR_PAUSE;
 
-    for (int i = 0; i < strnlen(ch, 10); i++) {             // allow up to a maximum of 10 morse code characters
+    for (size_t i = 0; i < strnlen(ch, 10); i++) {           // allow up to a maximum of 10 morse code characters
         if (ch[i] == '.') {
             cwchar = CHAR_DIT;
         } else if (ch[i] == '-') {
@@ -294,8 +553,11 @@ void CWGenerator::send_character(char *ch) {
  * @param ws2812_color: color of the Neopixel LED
  * @param ch: character to be send out
  */
-void CWGenerator::set_state(CW_CHARACTERS ch, uint32_t ws2812_color) {
+void __not_in_flash_func(CWGenerator::set_state)(CW_CHARACTERS ch, uint32_t ws2812_color) {
     put_pixel(ws2812_color);
+    if (key_gpio >= 0) {
+        gpio_put(key_gpio, ch != CHAR_PAUSE);
+    }
 
     switch (ch) {
         case CHAR_PAUSE:
@@ -324,16 +586,19 @@ void CWGenerator::set_state(CW_CHARACTERS ch, uint32_t ws2812_color) {
 /*
  * Updates the state machine and checks the paddle position
  */
-void CWGenerator::update_statemachine() {
-    int dit = debouncer.read(DIT_GPIO);
-    int dah = debouncer.read(DAH_GPIO);
+void __not_in_flash_func(CWGenerator::update_statemachine)() {
+    step_statemachine();
+    inchar_index += cw_sample_buffer_size;
+}
+
+/*
+ * steps the state machine by one packet without advancing the position within the current element
+ */
+void __not_in_flash_func(CWGenerator::step_statemachine)() {
+    int dit = paddles_enabled ? debouncer.read(DIT_GPIO) : 1;
+    int dah = paddles_enabled ? debouncer.read(DAH_GPIO) : 1;
     
-    if (curstate == STATE_INIT) {
-        inchar_index = 0;
-        inchar_endindex = cw_sample_rate / signal_buffer_period;  // wait for 1s to avoid start is not recorded
-        curstate = STATE_INIT_PAUSE;
-        printf("STATE_INIT_PAUSE\n");
-    } else if (curstate == STATE_IDLE) {
+    if (curstate == STATE_IDLE) {
         inchar_index = 0;
 
         if (nextstate == STATE_DIT) {
@@ -346,13 +611,23 @@ void CWGenerator::update_statemachine() {
             if (dit == 0) {
                 clear_queue();
                 set_state(CHAR_DIT, WS2812_COLOR_PADDLE);
+                latency_stats_element_start();
+                latency_pending = true;
             } else if (dah == 0) {
                 clear_queue();
                 set_state(CHAR_DAH, WS2812_COLOR_PADDLE);
+                latency_stats_element_start();
+                latency_pending = true;
             } else if (queue_try_remove(&cw_character_queue, &(curchar)) == true) {
                 set_state(curchar, WS2812_COLOR_SERIAL);
+                if (paddles_enabled) {
+                    latency_stats_disarm();     // the latency statistics follow the generator keyed by the paddles
+                }
             } else {
                 put_pixel(WS2812_COLOR_OFF);
+                if (paddles_enabled) {
+                    latency_stats_arm();
+                }
             }
         }
         nextstate = STATE_IDLE;
@@ -382,9 +657,6 @@ void CWGenerator::update_statemachine() {
                     // printf("STATE_IDLE\n");
                 }
                 break;
-            case STATE_INIT_PAUSE:
-                curstate = STATE_IDLE;
-                break;
             default:
                 // shouldn't happen
                 printf("Illegal state.\n");
@@ -393,50 +665,202 @@ void CWGenerator::update_statemachine() {
     } else if ((curstate == STATE_DIT_PAUSE) || (curstate == STATE_DIT)) {
         // check alread during the pause and while tone is still playing for the status of the paddle to avoid missed key presses
         // only consider second half of DIT-phase
-        if ((dah == 0) && (inchar_index > inchar_endindex * 0.75)) {
+        if ((dah == 0) && (inchar_index * 4 > inchar_endindex * 3)) {
             nextstate = STATE_DAH;
         }
     } else if ((curstate == STATE_DAH_PAUSE) || (curstate == STATE_DAH)) {
         // check alread during the pause and while tone is still playing for the status of the paddle to avoid missed key presses
         // only consider second half of DIT-phase
-        if ((dit == 0) && (inchar_index > inchar_endindex * 0.75)) {
+        if ((dit == 0) && (inchar_index * 4 > inchar_endindex * 3)) {
             nextstate = STATE_DIT;
         }
     }
+}
 
-    inchar_index += cw_sample_buffer_size;
+/*
+ * aborts the current character, clears the character queue and returns to the idle state
+ */
+void CWGenerator::reset() {
+    if (forward_param(PARAM_RESET, 0)) {
+        return;
+    }
+    clear_queue();
+    curstate = STATE_IDLE;
+    nextstate = STATE_IDLE;
+    inchar_index = 0;
+    latency_pending = false;
+    if (key_gpio >= 0) {
+        gpio_put(key_gpio, false);
+    }
 }
 
 /*
- * Returns the audio buffer for the next transmission
- * @return buffer consisting of an array of int16_t samples
+ * connects or disconnects the paddles
+ * @param enabled: true if the paddles key this generator
  */
-void *CWGenerator::get_audio_buffer() {
-    uint32_t pos;
+void CWGenerator::set_paddles(bool enabled) {
+    if (forward_param(PARAM_PADDLES, enabled)) {
+        return;
+    }
+    paddles_enabled = enabled;
+}
 
-    // always start with a clean buffer
-    memset(output_buffer, 0, sizeof(int16_t) * cw_sample_buffer_size);
+/*
+ * returns if the paddles key this generator
+ * @return true if the paddles are connected
+ */
+bool CWGenerator::get_paddles() {
+    return paddles_enabled;
+}
 
-    if ((curstate == STATE_DIT || curstate == STATE_DAH) && (cw_volume > 0)) {
-        for (int i = 0; i < cw_sample_buffer_size; i++) {
-            int curpos = inchar_index - cw_sample_buffer_size + i;                      
+/*
+ * sets the GPIO keying the radio of this generator
+ * @param gpio: keying output, -1: none
+ */
+void CWGenerator::set_key_gpio(int gpio) {
+    key_gpio = gpio;
+    if (gpio >= 0) {
+        gpio_init(gpio);
+        gpio_set_dir(gpio, true);
+        gpio_put(gpio, false);
+    }
+}
 
-            if (curpos < inchar_endindex) {
-                // we are still within the character
-                float curval = signal_buffer[curpos % signal_buffer_period];
+/*
+ * sets the function that may pass parameter changes on instead of applying them (NULL: apply directly)
+ * @param forwarder: function called by the setters
+ */
+void CWGenerator::set_param_forwarder(param_forwarder_t forwarder) {
+    param_forwarder = forwarder;
+}
 
+/*
+ * passes a parameter change to the forwarder
+ * @return true if the change must not be applied by the caller
+ */
+bool CWGenerator::forward_param(CW_PARAM param, uint32_t value) {
+    return (param_forwarder != NULL) && param_forwarder(this, param, value);
+}
 
-                // apply envelop shaping
-                if (curpos * cw_keyshape_stepsize < cw_risetime_samples_maxsize) {
-                    curval = curval * cw_keyshape[curpos * cw_keyshape_stepsize];
-                } else if ((inchar_endindex - curpos) * cw_keyshape_stepsize < cw_risetime_samples_maxsize) {
-                    curval = curval * cw_keyshape[(inchar_endindex - curpos) * cw_keyshape_stepsize];
-                }
-                output_buffer[i] = roundf(curval);
+/*
+ * changes a parameter by calling its setter
+ * @param param: parameter to be changed
+ * @param value: new value (see CW_PARAM)
+ */
+void CWGenerator::set_param(CW_PARAM param, uint32_t value) {
+    switch (param) {
+        case PARAM_FREQUENCY:
+            set_frequency(value);
+            break;
+        case PARAM_WPM:
+            set_wpm(value);
+            break;
+        case PARAM_RISETIME:
+            set_risetime(value / 100.0f);
+            break;
+        case PARAM_ENVELOPE:
+            set_envelope((CW_ENVELOPE)value);
+            break;
+        case PARAM_VOLUME:
+            set_volume(value);
+            break;
+        case PARAM_RESET:
+            reset();
+            break;
+        case PARAM_PADDLES:
+            set_paddles(value != 0);
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * checks if characters are queued or currently sent
+ * @return true if the generator is not idle or the character queue is not empty
+ */
+bool CWGenerator::is_busy() {
+    return (curstate != STATE_IDLE) || !queue_is_empty(&cw_character_queue);
+}
+
+/*
+ * recomputes the PIO clock dividers of the paddle debouncer and the Neopixel LED after the system
+ * clock was changed
+ */
+void CWGenerator::update_clock_dividers() {
+    debouncer.update_clock();
+    if (ws2812_sm < 0) {
+        return;                     // LED not initialized yet, init_deferred() uses the current clock
+    }
+    pio_sm_set_clkdiv(ws2812_pio, ws2812_sm, (float)clock_get_hz(clk_sys) / (WS2812_FREQ * (ws2812_T1 + ws2812_T2 + ws2812_T3)));
+}
+
+/*
+ * returns the number of characters waiting in the queue
+ * @return number of queued characters [0, queue_max_char]
+ */
+uint32_t CWGenerator::get_queue_level() {
+    return queue_get_level(&cw_character_queue);
+}
+
+/*
+ * renders the tone of an element multiplied by the rise and fall envelope
+ * @param params: tone, envelope and position of the packet within the element
+ * @param out: output samples
+ * @param count: number of samples
+ */
+void __not_in_flash_func(cw_render_tone)(const cw_tone_params_t *params, int16_t *out, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t curpos = params->start + i;
+
+        if (curpos < params->end) {
+            // we are still within the character
+            float curval = params->signal[curpos % params->signal_period];
+
+            // apply envelop shaping
+            if (curpos * params->keyshape_stepsize < params->keyshape_size) {
+                curval = curval * params->keyshape[curpos * params->keyshape_stepsize];
+            } else if ((params->end - curpos) * params->keyshape_stepsize < params->keyshape_size) {
+                curval = curval * params->keyshape[(params->end - curpos) * params->keyshape_stepsize];
             }
+            out[i] = roundf(curval);
         }
     }
-    
+}
+
+/*
+ * reports the first packet carrying the tone of a paddle element to the latency statistics
+ * @param count: number of samples in the output buffer
+ */
+void __not_in_flash_func(CWGenerator::report_tone_sent)(uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (output_buffer[i] != 0) {
+            latency_stats_tone_sent();
+            latency_pending = false;
+            break;
+        }
+    }
+}
+
+/*
+ * Returns the audio buffer for the next transmission
+ * @return buffer consisting of an array of int16_t samples
+ */
+void *__not_in_flash_func(CWGenerator::get_audio_buffer)() {
+    // always start with a clean buffer
+    memset(output_buffer, 0, sizeof(int16_t) * cw_sample_buffer_size);
+
+    if ((curstate == STATE_DIT || curstate == STATE_DAH) && (cw_volume > 0) && (cw_keyshape != NULL)) {
+        cw_tone_params_t params = {signal_buffer, signal_buffer_period, cw_keyshape, cw_risetime_samples_maxsize, cw_keyshape_stepsize,
+                                   inchar_index - cw_sample_buffer_size, inchar_endindex};
+        CW_RENDER_TONE(&params, output_buffer, cw_sample_buffer_size);
+
+        // report the first packet carrying the tone of a paddle element to the latency statistics
+        if (latency_pending) {
+            report_tone_sent(cw_sample_buffer_size);
+        }
+    }
+
     return output_buffer;
 }
 
@@ -39,8 +39,17 @@
 
 /* 
  * class that generates and audio buffer that contains morse code signals.
+ * Several generators may run side by side, e.g. one per radio of a two-radio (SO2R) station. Each has its own
+ * character queue, timing, sine period and keying output. The keyshape tables are shared: one table per envelope
+ * in use, generated on the heap by the first generator selecting it and freed with the last one leaving it. They
+ * are not kept as constant tables in flash because the rendering reads them for every sample from RAM, all
+ * envelopes would not fit into the XIP cache. The paddles and the Neopixel LED are shared as well, the paddles key
+ * the generators they are connected to (see set_paddles()). Each generator renders its own packet, the caller
+ * mixes them (the firmware mixes all radios into the single channel of the microphone stream).
  */
 
+#define KEYSHAPE_TABLES_MAX 8       // maximum number of shared keyshape tables (envelopes and sample rates in use)
+
 #define DIT_GPIO 3                  // GPIO port for the DIT paddle
 #define DIT_UNITS 1                 // number of time units for a DIT
 #define DAH_GPIO 4                  // GPIO port for the DAH paddle
@@ -64,6 +73,58 @@
 
 #define LPF_HALFORDER 4/2           // order / 2 of the Butterworth low pass filter
 
+/*
+ * parameters of the tone rendering of one audio packet
+ */
+typedef struct {
+    const float *signal;                    // single period of the tone
+    uint32_t signal_period;                 // number of samples of a period
+    const float *keyshape;                  // rising half of the Blackman-Harris window
+    uint32_t keyshape_size;                 // number of entries in keyshape
+    uint32_t keyshape_stepsize;             // step size between samples in keyshape
+    uint32_t start;                         // index of the first sample of the packet within the element
+    uint32_t end;                           // number of samples of the element
+} cw_tone_params_t;
+
+/*
+ * renders the tone of an element multiplied by the rise and fall envelope. Samples behind the end of
+ * the element are not written
+ * @param params: tone, envelope and position of the packet within the element
+ * @param out: output samples
+ * @param count: number of samples
+ */
+void cw_render_tone(const cw_tone_params_t *params, int16_t *out, uint32_t count);
+
+/*
+ * renders the tone of an element like cw_render_tone for a packet size known at compile time. The position
+ * within the signal period is advanced incrementally, so only one division is needed per packet
+ * @param params: tone, envelope and position of the packet within the element
+ * @param out: output samples (COUNT samples)
+ */
+template <uint32_t COUNT>
+__force_inline void cw_render_tone_fixed(const cw_tone_params_t *params, int16_t *out) {
+    uint32_t phase = params->start % params->signal_period;
+
+    for (uint32_t i = 0; i < COUNT; i++) {
+        uint32_t curpos = params->start + i;
+
+        if (curpos < params->end) {
+            // we are still within the character
+            float curval = params->signal[phase];
+
+            // apply envelop shaping
+            if (curpos * params->keyshape_stepsize < params->keyshape_size) {
+                curval = curval * params->keyshape[curpos * params->keyshape_stepsize];
+            } else if ((params->end - curpos) * params->keyshape_stepsize < params->keyshape_size) {
+                curval = curval * params->keyshape[(params->end - curpos) * params->keyshape_stepsize];
+            }
+            out[i] = roundf(curval);
+        }
+
+        phase = (phase + 1 == params->signal_period) ? 0 : phase + 1;
+    }
+}
+
 class CWGenerator
 {
 public:
@@ -80,8 +141,6 @@ public:
 
     // Different states of the morse code state machine
     typedef enum {
-        STATE_INIT,
-        STATE_INIT_PAUSE,
         STATE_IDLE,
         STATE_DIT,
         STATE_DIT_PAUSE,
@@ -89,6 +148,34 @@ public:
         STATE_DAH_PAUSE
     } CW_STATE;
 
+    // Envelope shapes of the rising and falling edges
+    typedef enum {
+        ENVELOPE_BLACKMAN_HARRIS,
+        ENVELOPE_BLACKMAN,
+        ENVELOPE_RAISED_COSINE,
+        ENVELOPE_LINEAR
+    } CW_ENVELOPE;
+
+    // Parameters changed by the setters, used to pass changes to the core running the generator
+    typedef enum {
+        PARAM_FREQUENCY,                        // set_frequency(), value in Hz
+        PARAM_WPM,                              // set_wpm(), value in WPM
+        PARAM_RISETIME,                         // set_risetime(), value in 1/100 ms
+        PARAM_ENVELOPE,                         // set_envelope(), value is a CW_ENVELOPE
+        PARAM_VOLUME,                           // set_volume(), value in %
+        PARAM_RESET,                            // reset(), value is ignored
+        PARAM_PADDLES                           // set_paddles(), value 0 or 1
+    } CW_PARAM;
+
+    /*
+     * called by the setters before the change is applied
+     * @param cwgen: generator whose parameter is changed
+     * @param param: changed parameter
+     * @param value: new value
+     * @return true if the change was passed on (e.g. to another core) and must not be applied by the caller
+     */
+    typedef bool (*param_forwarder_t)(CWGenerator *cwgen, CW_PARAM param, uint32_t value);
+
     /* 
      * constructor for the morse code sound generator with default frequency and speed
      * @param sample_rate: sample rate of the audio signal
@@ -107,6 +194,11 @@ public:
      */
     CWGenerator(uint32_t sample_rate, uint32_t sample_buffer_size, uint16_t freq, uint16_t wpm, uint16_t volume, float risetime);
 
+    /*
+     * leaves the shared keyshape table, the table is freed if no other generator uses it
+     */
+    virtual ~CWGenerator();
+
     /* 
      * set the audio frequency in Hz of the sine wave
      * @param freq: frequency of the audio signal.
@@ -144,6 +236,19 @@ public:
      */
     float get_risetime();
 
+    /*
+     * set the envelope shape of the rising and falling edges. If its keyshape table cannot be generated (all
+     * KEYSHAPE_TABLES_MAX entries in use or no memory), the previous envelope is kept
+     * @param envelope: envelope shape
+     */
+    void set_envelope(CW_ENVELOPE envelope);
+
+    /*
+     * get the envelope shape of the rising and falling edges
+     * @return envelope shape
+     */
+    CW_ENVELOPE get_envelope();
+
     /* 
      * set the volume of the morse signal [0:100]
      * @param volume: volume [%] of the morse signal
@@ -171,21 +276,94 @@ public:
     /*
      * Updates the state machine and checks the paddle position
      */
-    void update_statemachine();
+    virtual void update_statemachine();
+
+    /*
+     * aborts the current character, clears the character queue and returns to the idle state
+     */
+    void reset();
+
+    /*
+     * connects or disconnects the paddles. The paddles are shared by all generators, in a two-radio setup
+     * they key the generator of the selected radio. Only this generator arms the paddle-to-audio latency statistics
+     * @param enabled: true if the paddles key this generator
+     */
+    void set_paddles(bool enabled);
+
+    /*
+     * returns if the paddles key this generator
+     * @return true if the paddles are connected
+     */
+    bool get_paddles();
+
+    /*
+     * sets the GPIO keying the radio of this generator. The GPIO is high while a DIT or DAH is sent
+     * @param gpio: keying output, -1: none
+     */
+    void set_key_gpio(int gpio);
+
+    /*
+     * sets the function that may pass parameter changes on instead of applying them (NULL: apply directly)
+     * @param forwarder: function called by the setters
+     */
+    void set_param_forwarder(param_forwarder_t forwarder);
+
+    /*
+     * changes a parameter by calling its setter
+     * @param param: parameter to be changed
+     * @param value: new value (see CW_PARAM)
+     */
+    void set_param(CW_PARAM param, uint32_t value);
+
+    /*
+     * checks if characters are queued or currently sent
+     * @return true if the generator is not idle or the character queue is not empty
+     */
+    bool is_busy();
+
+    /*
+     * returns the number of characters waiting in the queue
+     * @return number of queued characters [0, queue_max_char]
+     */
+    uint32_t get_queue_level();
+
+    /*
+     * recomputes the PIO clock dividers of the paddle debouncer and the Neopixel LED after the system
+     * clock was changed
+     */
+    void update_clock_dividers();
+
+    /*
+     * generates the keyshape table and initializes the Neopixel LED. Called by the constructors unless the
+     * initialization was deferred, then it must be called once before the first packet is rendered, e.g. by
+     * the core running the generator while the other core brings up USB
+     */
+    void init_deferred();
 
     /* 
      * Returns the audio buffer for the next transmission
      * @return buffer consisting of an array of int16_t samples
      */
-    void *get_audio_buffer();
+    virtual void *get_audio_buffer();
 
     /* 
      * Returns the audio buffer size for the next transmission
      * @return buffer size in uint32_t
      */
-    uint32_t get_audio_buffer_size();
+    virtual uint32_t get_audio_buffer_size();
+
+protected:
+    /*
+     * constructor for derived classes that provide the audio buffers (see CWGeneratorFixed)
+     * @param sample_rate: sample rate of the audio signal
+     * @param sample_buffer_size: size of the buffer used to transmit the audio signal
+     * @param output: output buffer of sample_buffer_size + 1 samples
+     * @param signal: buffer for one period of the lowest frequency
+     * @param queue: storage of the character queue, (queue_max_char + 1) * sizeof(CW_CHARACTERS) bytes
+     * @param defer: true to leave the keyshape table and the Neopixel LED to init_deferred()
+     */
+    CWGenerator(uint32_t sample_rate, uint32_t sample_buffer_size, int16_t *output, float *signal, uint8_t *queue, bool defer);
 
-private:
     uint32_t cw_sample_rate;                    // sample rate of the audio signal
     uint32_t cw_sample_buffer_size;             // size of the sample buffer used to transmit the audio signal
     uint8_t cw_wpm;                             // CW speed in WPM
@@ -194,8 +372,9 @@ private:
     float cw_risetime;                          // rise time of keyed signal in ms
     uint32_t cw_risetime_samples;               // nr. of samples for the rise time
     uint32_t cw_risetime_samples_maxsize;       // maximum number of samples for rise time
-    float *cw_keyshape;                         // buffer containing the key shape factors of the Blackman window
+    const float *cw_keyshape;                   // shared table of the key shape factors of the envelope
     uint32_t cw_keyshape_stepsize;              // step size between samples in keyshape table
+    CW_ENVELOPE cw_envelope;                    // envelope shape stored in the keyshape table
 
     float *signal_buffer;                     // buffer containing a single sine wave
     int16_t *output_buffer;                     // buffer used to tramsmit the audio to the USB port
@@ -203,7 +382,9 @@ private:
     uint32_t signal_dit_length_index;           // number of samples for a DIT in the current CW speed
 
     queue_t cw_character_queue;                 // used to send characters to the morse code state machine
-    Debounce debouncer;                         // Debouncer used for the paddle input
+    static Debounce debouncer;                  // Debouncer used for the paddle input, shared by all generators
+    bool paddles_enabled;                       // the paddles key this generator
+    int key_gpio;                               // keying output of the radio, -1: none
 
     CW_CHARACTERS curchar;
     CW_STATE curstate;                          // current state of the state machine
@@ -211,15 +392,78 @@ private:
 
     uint32_t inchar_index;                      // sound buffer index within the current morse character
     uint32_t inchar_endindex;                   // end index in number of tone_buffer_periods
+    bool latency_pending;                       // paddle element started, first packet with tone not yet sent
+
+    param_forwarder_t param_forwarder;          // passes parameter changes to the core running the generator
+
+    static PIO ws2812_pio;                      // PIO used for the Neopixel LED, shared by all generators
+    static volatile int ws2812_sm;              // PIO statemachine for Neopixel LED, -1 until init_deferred()
+
+    /*
+     * initializes the generator and the paddles, the keyshape table and the Neopixel LED unless defer is set.
+     * The buffers must be set, the character queue is allocated on the heap if queue is NULL
+     */
+    void init_generator(uint32_t sample_rate, uint32_t sample_buffer_size, uint16_t freq, uint16_t wpm, uint16_t volume, float risetime,
+                        uint8_t *queue, bool defer);
 
-    PIO ws2812_pio;                             // PIO used for the Neopixel LED
-    int ws2812_sm;                              // PIO statemachine for Neopixel LED
+    /*
+     * reports the first packet carrying the tone of a paddle element to the latency statistics
+     * @param count: number of samples in the output buffer
+     */
+    void report_tone_sent(uint32_t count);
+
+    /*
+     * passes a parameter change to the forwarder
+     * @return true if the change must not be applied by the caller
+     */
+    bool forward_param(CW_PARAM param, uint32_t value);
 
     /*
      * initializes the audio buffers for the currently set frequency
      */
     void init_buffers();
 
+    /*
+     * computes the tone period, the DIT length and the rise time in samples for the current settings. Called by
+     * init_buffers(), derived classes with a fixed sample rate pass it as a constant to compute_timing()
+     */
+    virtual void update_timing();
+
+    /*
+     * computes the tone period, the DIT length and the rise time in samples
+     * @param sample_rate: sample rate of the audio signal
+     */
+    __force_inline void compute_timing(uint32_t sample_rate) {
+        signal_buffer_period = ceil(sample_rate / (float)(cw_frequency));
+        signal_dit_length_index = (60 / (50 * (float)(cw_wpm))) * sample_rate;                                            // length of DIT t_dit = 60 / (50 * wpm). Source: https://morsecode.world/international/timing.html
+        signal_dit_length_index = ceil((float)(signal_dit_length_index) / signal_buffer_period) * signal_buffer_period;   // must be a whole multiple of the tone period to ensure tone ends after a full period
+
+        // calculate nr. of samples for envelope shaping
+        cw_risetime_samples = ceil(cw_risetime * sample_rate / 1000);
+        cw_risetime_samples = cw_risetime_samples > signal_dit_length_index/2 ? signal_dit_length_index/2 : cw_risetime_samples;
+
+        // calculate step size for envelope shaping
+        cw_keyshape_stepsize = ceil(cw_risetime_samples_maxsize / cw_risetime_samples);
+    }
+
+    /*
+     * steps the state machine by one packet without advancing the position within the current element
+     */
+    void step_statemachine();
+
+    /*
+     * selects the shared keyshape table of an envelope, generates it if no other generator uses it. On failure the
+     * previous table is kept, a generator without table renders silence
+     * @param envelope: envelope shape
+     * @return false if no table entry is free or the table could not be allocated
+     */
+    bool init_keyshape(CW_ENVELOPE envelope);
+
+    /*
+     * leaves the shared keyshape table, the table is freed if no other generator uses it
+     */
+    void release_keyshape();
+
     /*
      * initializes the Butterworth low pass filter
      */
@@ -244,4 +488,80 @@ private:
     inline void put_pixel(uint32_t pixel_grb);
 };
 
+/*
+ * morse code sound generator for a sample rate and packet size fixed at compile time. The output and sine
+ * buffers and the storage of the character queue are part of the object, so a statically allocated instance
+ * only uses the heap for the keyshape tables shared by all generators (see init_keyshape()). The packet
+ * rendering is unrolled for the packet size and the state machine and timing use the format as constants.
+ * Calls through a pointer to this class are resolved at compile time and inlined, calls through a CWGenerator
+ * pointer use the out-of-line copies. Use CWGenerator for builds that select the sample rate at runtime
+ */
+template <uint32_t SAMPLE_RATE_T, uint32_t BUFFER_SIZE_T>
+class CWGeneratorFixed final : public CWGenerator
+{
+public:
+    static_assert(BUFFER_SIZE_T > 0, "packet size must not be zero");
+
+    /*
+     * constructor for the morse code sound generator with default frequency and speed
+     * @param defer: true to leave the keyshape table and the Neopixel LED to init_deferred()
+     */
+    explicit CWGeneratorFixed(bool defer = false)
+        : CWGenerator(SAMPLE_RATE_T, BUFFER_SIZE_T, output_storage, signal_storage, queue_storage, defer) {}
+
+    /*
+     * Returns the audio buffer for the next transmission. Always inlined, because template members are not
+     * placed in RAM by __not_in_flash_func, call it from a function in RAM
+     * @return buffer consisting of an array of int16_t samples
+     */
+    __force_inline void *get_audio_buffer() override {
+        // always start with a clean buffer
+        memset(output_storage, 0, sizeof(int16_t) * BUFFER_SIZE_T);
+
+        if ((curstate == STATE_DIT || curstate == STATE_DAH) && (cw_volume > 0) && (cw_keyshape != NULL)) {
+            cw_tone_params_t params = {signal_storage, signal_buffer_period, cw_keyshape, cw_risetime_samples_maxsize, cw_keyshape_stepsize,
+                                       inchar_index - BUFFER_SIZE_T, inchar_endindex};
+            cw_render_tone_fixed<BUFFER_SIZE_T>(&params, output_storage);
+
+            // report the first packet carrying the tone of a paddle element to the latency statistics
+            if (latency_pending) {
+                report_tone_sent(BUFFER_SIZE_T);
+            }
+        }
+
+        return output_storage;
+    }
+
+    /*
+     * Returns the audio buffer size for the next transmission
+     * @return buffer size in uint32_t
+     */
+    uint32_t get_audio_buffer_size() override {
+        return sizeof(int16_t) * BUFFER_SIZE_T;
+    }
+
+    /*
+     * Updates the state machine and checks the paddle position. Always inlined like get_audio_buffer()
+     */
+    __force_inline void update_statemachine() override {
+        step_statemachine();
+        inchar_index += BUFFER_SIZE_T;
+    }
+
+protected:
+    /*
+     * computes the tone period, the DIT length and the rise time in samples for the fixed sample rate
+     */
+    void update_timing() override {
+        compute_timing(SAMPLE_RATE_T);
+    }
+
+private:
+    const static uint32_t signal_maxsize = (SAMPLE_RATE_T + audio_minfreq - 1) / audio_minfreq;  // one period of the lowest frequency
+
+    int16_t output_storage[BUFFER_SIZE_T + 1];  // buffer used to transmit the audio to the USB port
+    float signal_storage[signal_maxsize];       // buffer containing a single sine wave
+    uint8_t queue_storage[sizeof(CW_CHARACTERS) * (queue_max_char + 1)];  // storage of the character queue
+};
+
 #endif
\ No newline at end of file
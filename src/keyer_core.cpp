@@ -0,0 +1,362 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "keyer_core.h"
+
+#include "pico/multicore.h"
+#include "hardware/structs/bus_ctrl.h"
+#include "hardware/sync.h"
+#include "boot_stats.h"
+#include "latency_stats.h"
+#include "led_health.h"
+#include "led_service.h"
+#include "mem_stats.h"
+#include "pc_profiler.h"
+#include "power_manager.h"
+#include "scheduler.h"
+#include "self_benchmark.h"
+#include "trainer.h"
+
+/*
+ * keyer, rendering and LED services on core 1 run as tasks of the core 1 scheduler, packets are passed to
+ * core 0 through a packet ring
+ * inter-core FIFO message: bits 31..24 CWGenerator::CW_PARAM or KEYER_MSG_PAUSE, bits 23..20 generator, bits 19..0 value
+ * The packet ring is placed in the scratch X bank next to the stack of core 1 and the silence packet in the
+ * scratch Y bank of core 0, so neither competes with the striped main SRAM used by USB and DMA.
+ */
+
+#define KEYER_MSG_PAUSE 0xFF                // parks core 1 until keyer_core_resume()
+#define KEYER_SCRATCH_X_SIZE 4096           // size of the scratch X bank (SCRATCH_X in the linker script)
+#define KEYER_MSG(id, index, value) (((uint32_t)(id) << 24) | ((uint32_t)(index) << 20) | ((value) & 0x000FFFFF))
+
+static PicoCWGenerator *keyer_cwgens[KEYER_MAX_GENERATORS];
+static uint32_t keyer_count = 0;                    // number of generators
+static packet_ring_t __scratch_x("keyer_core") packet_ring;
+static int16_t __scratch_x("keyer_core") packet_storage[PACKET_RING_MAX_SLOTS * SAMPLE_BUFFER_SIZE];
+static bool __scratch_x("keyer_core") packet_tone[PACKET_RING_MAX_SLOTS];  // packet carries the first tone of a measured element
+static int16_t __scratch_y("keyer_core") silence[SAMPLE_BUFFER_SIZE];      // sent if no packet is ready
+
+// the stack of core 1 (PICO_CORE1_STACK_SIZE) is placed at the top of the scratch X bank, the ring below it
+static_assert(sizeof(packet_ring) + sizeof(packet_storage) + sizeof(packet_tone) + PICO_CORE1_STACK_SIZE <= KEYER_SCRATCH_X_SIZE,
+              "packet ring and stack of core 1 exceed the scratch X bank");
+static bool packet_from_ring = false;               // the packet returned by keyer_core_read_packet() is in the ring
+static volatile uint32_t underruns = 0;             // packets not rendered in time (written by core 0)
+static volatile bool pause_requested = false;
+static volatile bool parked = false;                // core 1 is parked, core 0 owns the generator
+static volatile bool stream_open = false;           // the host records the microphone, packets are rendered
+static volatile bool keyer_ready = false;           // deferred initialization of the generator finished on core 1
+static volatile bool underruns_held = false;        // core 1 was parked, no underruns until it renders again
+static uint32_t reported_underruns = 0;             // underruns already passed to the LED health mode
+static scheduler_t keyer_scheduler;
+
+/*
+ * parameter forwarder of the generator: changes made on core 0 are sent to core 1
+ * @return true if the change was sent and must not be applied by the caller
+ */
+static bool forward_param(CWGenerator *cwgen, CWGenerator::CW_PARAM param, uint32_t value) {
+    if ((get_core_num() == 1) || parked) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < keyer_count; i++) {
+        if (keyer_cwgens[i] == cwgen) {
+            multicore_fifo_push_blocking(KEYER_MSG(param, i, value));
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * applies the parameter changes and pause requests sent by core 0
+ */
+static void __not_in_flash_func(process_messages)() {
+    while (multicore_fifo_rvalid()) {
+        uint32_t msg = multicore_fifo_pop_blocking();
+
+        if ((msg >> 24) == KEYER_MSG_PAUSE) {
+            parked = true;
+            while (pause_requested) {
+                __wfe();                            // woken by keyer_core_resume()
+            }
+            parked = false;
+        } else {
+            keyer_cwgens[(msg >> 20) & 0x0F]->set_param((CWGenerator::CW_PARAM)(msg >> 24), msg & 0x000FFFFF);
+        }
+    }
+}
+
+/*
+ * ready function of the render task
+ * @return true if a message of core 0 is waiting or a slot of the packet ring is free while the stream is open
+ */
+static bool __not_in_flash_func(keyer_render_ready)() {
+    return multicore_fifo_rvalid() || (stream_open && (packet_ring_write_slot(&packet_ring) != NULL));
+}
+
+/*
+ * adds the packet of a generator to the packet of the other generators
+ * @param out: mixed packet
+ * @param in: packet of the generator, SAMPLE_BUFFER_SIZE samples
+ */
+static void __not_in_flash_func(keyer_mix)(int16_t *out, const int16_t *in) {
+    for (uint32_t i = 0; i < SAMPLE_BUFFER_SIZE; i++) {
+        int32_t sum = out[i] + in[i];
+        out[i] = sum > INT16_MAX ? INT16_MAX : (sum < INT16_MIN ? INT16_MIN : sum);
+    }
+}
+
+/*
+ * render task (polled): applies the messages of core 0, then renders the next packet and advances the state
+ * machine as soon as a slot of the packet ring is free, so the timeline is paced by the USB stream. Nothing is
+ * rendered and the keyer does not advance while the stream is closed. The generators of all radios and the
+ * stations of the trainer are mixed into the packet
+ */
+static void __not_in_flash_func(keyer_render_task)() {
+    process_messages();
+
+    int16_t *slot = stream_open ? packet_ring_write_slot(&packet_ring) : NULL;
+    if (slot == NULL) {
+        return;
+    }
+
+    led_health_frame();
+    led_health_work_begin();
+
+    memcpy(slot, keyer_cwgens[0]->get_audio_buffer(), sizeof(int16_t) * SAMPLE_BUFFER_SIZE);
+    keyer_cwgens[0]->update_statemachine();
+    for (uint32_t i = 1; i < keyer_count; i++) {
+        keyer_mix(slot, (const int16_t *)keyer_cwgens[i]->get_audio_buffer());
+        keyer_cwgens[i]->update_statemachine();
+    }
+    trainer_render(slot, SAMPLE_BUFFER_SIZE);
+    packet_tone[packet_ring.head % PACKET_RING_MAX_SLOTS] = latency_stats_take_tone_rendered();
+    packet_ring_commit(&packet_ring);
+
+    led_health_work_end();
+}
+
+/*
+ * LED task (periodic): passes the underruns to the health mode and updates the LED
+ */
+static void keyer_led_task() {
+    uint32_t count = underruns;
+    led_health_underruns(count - reported_underruns);
+    reported_underruns = count;
+
+    uint32_t level = 0;
+    for (uint32_t i = 0; i < keyer_count; i++) {
+        uint32_t queued = keyer_cwgens[i]->get_queue_level();
+        level = queued > level ? queued : level;
+    }
+    led_health_task(level, CWGenerator::queue_max_char);
+    led_service_task();
+}
+
+/*
+ * keyer loop of core 1, sleeps until core 0 frees a packet or sends a message, or the LED task is due
+ */
+static void __not_in_flash_func(keyer_core_main)() {
+    while (true) {
+        if (!scheduler_run_once(&keyer_scheduler)) {
+            power_manager_sleep(scheduler_next_release_us(&keyer_scheduler));
+        }
+    }
+}
+
+/*
+ * entry of core 1: finishes the initialization of the generator while core 0 services USB, then runs the
+ * keyer loop
+ */
+static void keyer_core_entry() {
+    pc_profiler_init_core();                        // the sampling interrupt must be enabled on this core
+    for (uint32_t i = 0; i < keyer_count; i++) {
+        keyer_cwgens[i]->init_deferred();
+    }
+    keyer_ready = true;
+    boot_stats_mark(BOOT_KEYER_READY);
+
+    keyer_core_main();
+}
+
+/*
+ * passes parameter changes of the generators to core 1 and starts the keyer loop on core 1
+ * @param cwgens: generators run by core 1, constructed with deferred initialization
+ * @param count: number of generators [1, KEYER_MAX_GENERATORS]
+ */
+void keyer_core_launch(PicoCWGenerator **cwgens, uint32_t count) {
+    keyer_count = count < KEYER_MAX_GENERATORS ? count : KEYER_MAX_GENERATORS;
+    for (uint32_t i = 0; i < keyer_count; i++) {
+        keyer_cwgens[i] = cwgens[i];
+        cwgens[i]->set_param_forwarder(forward_param);
+    }
+    packet_ring_init(&packet_ring, packet_storage, SAMPLE_BUFFER_SIZE, KEYER_CORE_DEPTH);
+    mem_stats_account("packet ring scratch_x", sizeof(packet_storage));
+
+    // core 1 wins the bus arbitration against core 0 and DMA if they access the same SRAM bank
+    bus_ctrl_hw->priority = BUSCTRL_BUS_PRIORITY_PROC1_BITS;
+
+    // the first tone packet is measured when it is passed to the USB stack, not when it is rendered
+    latency_stats_defer(true);
+
+    scheduler_init(&keyer_scheduler, "core1");
+    scheduler_add(&keyer_scheduler, "render", keyer_render_task, keyer_render_ready, 0, KEYER_RENDER_DEADLINE_US);
+    scheduler_add(&keyer_scheduler, "led", keyer_led_task, NULL, KEYER_LED_PERIOD_US, KEYER_LED_DEADLINE_US);
+    multicore_launch_core1(keyer_core_entry);
+}
+
+/*
+ * returns the next packet for the USB stream (core 0)
+ * @return SAMPLE_BUFFER_SIZE samples, valid until keyer_core_release_packet()
+ */
+const int16_t *__not_in_flash_func(keyer_core_read_packet)() {
+    const int16_t *packet = packet_ring_read_slot(&packet_ring);
+
+    packet_from_ring = (packet != NULL);
+    if (packet == NULL) {
+        if (keyer_ready && !underruns_held) {
+            underruns = underruns + 1;          // silence while core 1 is initializing or parked is expected
+        }
+        return silence;
+    }
+    underruns_held = false;
+    return packet;
+}
+
+/*
+ * hands the packet returned by keyer_core_read_packet() back to core 1
+ */
+void __not_in_flash_func(keyer_core_release_packet)() {
+    if (!packet_from_ring) {
+        return;
+    }
+
+    boot_stats_mark(BOOT_FIRST_PACKET);
+    if (packet_tone[packet_ring.tail % PACKET_RING_MAX_SLOTS]) {
+        latency_stats_packet_sent();
+        power_manager_tone_sent();
+    }
+    packet_ring_release(&packet_ring);
+    packet_from_ring = false;
+    __sev();                                        // wake core 1 to render into the free slot
+}
+
+/*
+ * starts or stops the rendering with the microphone stream (core 0, USB task)
+ * @param open: true if the host started the stream, false if it stopped it
+ */
+void keyer_core_stream(bool open) {
+    if (open == stream_open) {
+        return;
+    }
+
+    if (open) {
+        // packets rendered before the stream was closed are outdated
+        while (packet_ring_read_slot(&packet_ring) != NULL) {
+            packet_ring_release(&packet_ring);
+        }
+        packet_from_ring = false;
+        stream_open = true;
+        boot_stats_mark(BOOT_STREAM_OPEN);
+        __sev();                                    // wake core 1 to fill the ring
+    } else {
+        stream_open = false;
+        for (uint32_t i = 0; i < keyer_count; i++) {
+            keyer_cwgens[i]->reset();               // the rest of the character would not be heard
+        }
+    }
+}
+
+/*
+ * changes the number of packets rendered ahead of the USB stream
+ * @param depth: packets rendered ahead, limited to [1, PACKET_RING_MAX_SLOTS], 0 keeps the depth
+ * @return depth in use
+ */
+uint32_t keyer_core_set_depth(uint32_t depth) {
+    if (depth == 0) {
+        return packet_ring.depth;
+    }
+    return packet_ring_set_depth(&packet_ring, depth);
+}
+
+/*
+ * parks core 1 until keyer_core_resume()
+ */
+void keyer_core_pause() {
+    underruns_held = true;                          // counted again with the first packet after keyer_core_resume()
+    pause_requested = true;
+    multicore_fifo_push_blocking(KEYER_MSG(KEYER_MSG_PAUSE, 0, 0));
+    while (!parked) {
+        tight_loop_contents();
+    }
+}
+
+/*
+ * continues the keyer loop on core 1
+ */
+void keyer_core_resume() {
+    pause_requested = false;
+    __sev();
+    while (parked) {
+        tight_loop_contents();
+    }
+}
+
+/*
+ * controls the pile-up trainer, stations and noise are changed while core 1 is parked
+ * @param op: 0: stop, 1: start <arg> stations (0: default), 2: noise level <arg> [%], 3: report,
+ *            4: benchmark with <arg> * 10 iterations (0: default)
+ * @param arg: argument of the operation
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t keyer_core_trainer(uint32_t op, uint32_t arg, char *buf, uint32_t maxsize) {
+    switch (op) {
+        case 0:
+            keyer_core_pause();
+            trainer_stop();
+            keyer_core_resume();
+            break;
+        case 1:
+            keyer_core_pause();
+            trainer_start(arg > 0 ? arg : TRAINER_DEFAULT_STATIONS, time_us_32(), SAMPLE_RATE);
+            keyer_core_resume();
+            break;
+        case 2:
+            keyer_core_pause();
+            trainer_set_noise(arg);
+            keyer_core_resume();
+            break;
+        case 3:
+            return trainer_report(buf, maxsize);
+        case 4:
+            return self_benchmark_trainer(keyer_cwgens[0], arg > 0 ? arg * 10 : SELF_BENCHMARK_DEFAULT_ITERATIONS, buf,
+                                          maxsize);
+        default:
+            break;
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef _KEYER_CORE_H_
+#define _KEYER_CORE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "pico/stdlib.h"
+#include "cw_generator.h"
+#include "packet_ring.h"
+#include "usb_devices.h"
+
+/*
+ * runs the keyer on core 1: the state machine (paddles and keyer timeline), the packet rendering and the LED
+ * services. Finished packets are handed to the USB stack on core 0 through a lock-free packet ring, parameter
+ * changes made on core 0 (parser, USB volume) arrive over the inter-core FIFO and are applied by core 1
+ * between two packets. Characters are queued directly, the character queue is multicore safe. Core 1 sleeps
+ * while the ring is full, releasing a packet wakes it. In a two-radio setup one generator runs per radio, their
+ * tones are mixed into the microphone stream and each keys its radio on its own GPIO.
+ */
+
+#define KEYER_MAX_GENERATORS 2              // maximum number of generators (one per radio)
+#define KEYER_CORE_DEPTH 2                  // default number of packets rendered ahead of the USB stream
+#define KEYER_RENDER_DEADLINE_US 1000       // a packet has to be rendered within one USB frame
+#define KEYER_LED_PERIOD_US 10000           // period of the LED services
+#define KEYER_LED_DEADLINE_US 20000         // the LED may lag a few frames behind the audio
+
+typedef CWGeneratorFixed<SAMPLE_RATE, SAMPLE_BUFFER_SIZE> PicoCWGenerator;  // generator for the USB audio format
+
+/*
+ * passes parameter changes of the generators to core 1 and starts the keyer loop on core 1. Core 1 first
+ * calls init_deferred() of the generators, until then silence is sent without counting underruns
+ * @param cwgens: generators run by core 1, constructed with deferred initialization
+ * @param count: number of generators [1, KEYER_MAX_GENERATORS]
+ */
+void keyer_core_launch(PicoCWGenerator **cwgens, uint32_t count);
+
+/*
+ * returns the next packet for the USB stream (core 0). If no packet is ready, silence is returned and
+ * counted as underrun
+ * @return SAMPLE_BUFFER_SIZE samples, valid until keyer_core_release_packet()
+ */
+const int16_t *keyer_core_read_packet();
+
+/*
+ * hands the packet returned by keyer_core_read_packet() back to core 1 after it was passed to the USB stack
+ */
+void keyer_core_release_packet();
+
+/*
+ * starts or stops the rendering with the microphone stream. While the stream is closed core 1 renders nothing
+ * and the keyer does not advance, a character being sent when the stream stops is aborted. Keying is accepted
+ * with the first packet after the host starts the stream (core 0, USB task)
+ * @param open: true if the host started the stream, false if it stopped it
+ */
+void keyer_core_stream(bool open);
+
+/*
+ * changes the number of packets rendered ahead of the USB stream. Each packet adds 1 ms of latency and
+ * tolerates 1 ms more delay of the rendering on core 1
+ * @param depth: packets rendered ahead, limited to [1, PACKET_RING_MAX_SLOTS], 0 keeps the depth
+ * @return depth in use
+ */
+uint32_t keyer_core_set_depth(uint32_t depth);
+
+/*
+ * parks core 1 until keyer_core_resume(). Parameter changes made while core 1 is parked are applied
+ * directly, e.g. by the self-benchmark using the generator on core 0. The silence sent while core 1 is parked
+ * and until it rendered the next packet is not counted as underrun
+ */
+void keyer_core_pause();
+
+/*
+ * continues the keyer loop on core 1
+ */
+void keyer_core_resume();
+
+/*
+ * controls the pile-up trainer mixed into the microphone stream (core 0). Stations and the noise level are
+ * changed while core 1 is parked
+ * @param op: 0: stop, 1: start <arg> stations (0: TRAINER_DEFAULT_STATIONS), 2: noise level <arg> [%], 3: report,
+ *            4: self-benchmark of the trainer with <arg> * 10 iterations (0: default), stops the pile-up
+ * @param arg: argument of the operation
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t keyer_core_trainer(uint32_t op, uint32_t arg, char *buf, uint32_t maxsize);
+
+#endif
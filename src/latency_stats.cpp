@@ -0,0 +1,229 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "latency_stats.h"
+
+#include "hardware/gpio.h"
+
+/*
+ * measures the latency between a paddle contact closing and the first USB audio packet carrying the tone
+ */
+
+static volatile bool edge_armed = false;            // keyer is idle, the next falling edge starts a measurement
+static volatile bool edge_valid = false;            // edge_time contains the timestamp of a paddle contact
+static volatile uint32_t edge_time;                 // timestamp [us] of the first paddle contact after arming
+static bool tone_pending = false;                   // element started by the paddle, waiting for its first packet
+static bool deferred = false;                       // packets are rendered ahead, measure in latency_stats_packet_sent()
+static volatile bool tone_rendered = false;         // first packet with the tone is rendered but not yet sent
+
+static uint32_t hist[LATENCY_HIST_BUCKETS];         // log-scale histogram of the measured latencies
+static uint32_t hist_count;                         // number of measurements
+static uint32_t hist_min;                           // smallest measured latency [us]
+static uint32_t hist_max;                           // largest measured latency [us]
+static uint64_t hist_sum;                           // sum of all measured latencies [us]
+
+/*
+ * returns the histogram bucket of a latency value
+ * values < 4us are stored 1:1, above each octave is split into LATENCY_HIST_SUBBUCKETS buckets
+ */
+static uint32_t __not_in_flash_func(bucket_index)(uint32_t us) {
+    if (us < LATENCY_HIST_SUBBUCKETS) {
+        return us;
+    }
+
+    uint32_t msb = 31 - __builtin_clz(us);
+    uint32_t index = (msb - 1) * LATENCY_HIST_SUBBUCKETS + ((us >> (msb - 2)) & (LATENCY_HIST_SUBBUCKETS - 1));
+    return index < LATENCY_HIST_BUCKETS ? index : LATENCY_HIST_BUCKETS - 1;
+}
+
+/*
+ * returns the smallest latency value stored in a histogram bucket
+ */
+static uint32_t bucket_lower_bound(uint32_t index) {
+    if (index < LATENCY_HIST_SUBBUCKETS) {
+        return index;
+    }
+
+    uint32_t msb = index / LATENCY_HIST_SUBBUCKETS + 1;
+    return (LATENCY_HIST_SUBBUCKETS + index % LATENCY_HIST_SUBBUCKETS) << (msb - 2);
+}
+
+/*
+ * returns the latency below which the given fraction of all measurements is located
+ * the upper bound of the bucket is reported, limited to the largest measured value
+ * @param permille: fraction in 1/1000
+ */
+static uint32_t percentile(uint32_t permille) {
+    uint64_t threshold = ((uint64_t)hist_count * permille + 999) / 1000;
+    uint64_t sum = 0;
+
+    for (uint32_t i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        sum += hist[i];
+        if (sum >= threshold) {
+            uint32_t upper = bucket_lower_bound(i + 1) - 1;
+            return upper < hist_max ? upper : hist_max;
+        }
+    }
+    return hist_max;
+}
+
+/*
+ * adds a measured latency to the histogram and drops the edge
+ */
+static void __not_in_flash_func(record)(uint32_t latency) {
+    edge_valid = false;
+
+    hist[bucket_index(latency)]++;
+    hist_min = latency < hist_min ? latency : hist_min;
+    hist_max = latency > hist_max ? latency : hist_max;
+    hist_sum += latency;
+    hist_count++;
+}
+
+/*
+ * called from the GPIO interrupt of the paddles. Timestamps the first paddle contact after the keyer was armed
+ * @param gpio: GPIO that triggered the interrupt
+ * @param events: GPIO_IRQ_EDGE_FALL and/or GPIO_IRQ_EDGE_RISE
+ */
+void __not_in_flash_func(latency_stats_edge)(uint gpio, uint32_t events) {
+    (void)gpio;
+
+    if ((events & GPIO_IRQ_EDGE_FALL) && edge_armed && !edge_valid) {
+        edge_time = time_us_32();
+        edge_valid = true;
+    }
+}
+
+/*
+ * arms the edge detection. Called while the keyer is idle and both paddles are released
+ */
+void __not_in_flash_func(latency_stats_arm)() {
+    if (!edge_armed) {
+        edge_valid = false;
+        edge_armed = true;
+    } else if (edge_valid && (time_us_32() - edge_time > LATENCY_EDGE_TIMEOUT_US)) {
+        edge_valid = false;                         // contact was too short to pass the debouncer
+    }
+}
+
+/*
+ * disarms the edge detection and drops a pending edge
+ */
+void __not_in_flash_func(latency_stats_disarm)() {
+    edge_armed = false;
+    edge_valid = false;
+    tone_pending = false;
+}
+
+/*
+ * called when the keyer leaves the idle state because a paddle is pressed
+ */
+void __not_in_flash_func(latency_stats_element_start)() {
+    edge_armed = false;
+    tone_pending = edge_valid;
+}
+
+/*
+ * called when the first packet containing the tone of the started element is passed to the USB stack
+ */
+void __not_in_flash_func(latency_stats_tone_sent)() {
+    if (!tone_pending) {
+        return;
+    }
+
+    tone_pending = false;
+    if (deferred) {
+        tone_rendered = true;
+    } else {
+        record(time_us_32() - edge_time);
+    }
+}
+
+/*
+ * enables the deferred mode used if packets are rendered ahead of the USB stream
+ * @param defer: true to enable the deferred mode
+ */
+void latency_stats_defer(bool defer) {
+    deferred = defer;
+}
+
+/*
+ * returns and clears the mark set by latency_stats_tone_sent() in the deferred mode
+ * @return true if the tone of a measured element was rendered into the last packet
+ */
+bool __not_in_flash_func(latency_stats_take_tone_rendered)() {
+    bool rendered = tone_rendered;
+    tone_rendered = false;
+    return rendered;
+}
+
+/*
+ * finishes a deferred measurement when the tagged packet is passed to the USB stack
+ */
+void __not_in_flash_func(latency_stats_packet_sent)() {
+    record(time_us_32() - edge_time);
+}
+
+/*
+ * clears the histogram
+ */
+void latency_stats_reset() {
+    for (uint32_t i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        hist[i] = 0;
+    }
+    hist_count = 0;
+    hist_min = UINT32_MAX;
+    hist_max = 0;
+    hist_sum = 0;
+}
+
+/*
+ * writes a human readable report of the histogram (count, min, max, mean, percentiles, buckets)
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t latency_stats_report(char *buf, uint32_t maxsize) {
+    uint32_t len;
+
+    if (hist_count == 0) {
+        len = snprintf(buf, maxsize, "latency n=0\n");
+        return len < maxsize ? len : maxsize - 1;
+    }
+
+    len = snprintf(buf, maxsize, "latency n=%lu min=%lu max=%lu mean=%lu p50=%lu p90=%lu p99=%lu p999=%lu us\n",
+                   (unsigned long)hist_count, (unsigned long)hist_min, (unsigned long)hist_max,
+                   (unsigned long)(hist_sum / hist_count), (unsigned long)percentile(500),
+                   (unsigned long)percentile(900), (unsigned long)percentile(990), (unsigned long)percentile(999));
+
+    for (uint32_t i = 0; (i < LATENCY_HIST_BUCKETS) && (len < maxsize); i++) {
+        if (hist[i] > 0) {
+            len += snprintf(buf + len, maxsize - len, "%lu-%lu: %lu\n", (unsigned long)bucket_lower_bound(i),
+                            (unsigned long)(bucket_lower_bound(i + 1) - 1), (unsigned long)hist[i]);
+        }
+    }
+
+    return len < maxsize ? len : maxsize - 1;
+}
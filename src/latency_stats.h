@@ -0,0 +1,108 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef _LATENCY_STATS_H_
+#define _LATENCY_STATS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "pico/stdlib.h"
+
+/*
+ * measures the latency between a paddle contact closing and the first USB audio packet carrying the tone
+ * of the element started by that contact. The raw paddle GPIOs are timestamped in the GPIO interrupt while
+ * the keyer is idle, the CWGenerator reports when the element starts and when its first non-zero packet
+ * is handed to the USB stack. The deltas are collected in a log-scale histogram.
+ */
+
+#define LATENCY_HIST_SUBBUCKETS 4           // number of buckets per octave (resolution ~19%)
+#define LATENCY_HIST_OCTAVES 20             // highest octave covers up to 2^20 us (~1s)
+#define LATENCY_HIST_BUCKETS (LATENCY_HIST_OCTAVES * LATENCY_HIST_SUBBUCKETS)
+#define LATENCY_EDGE_TIMEOUT_US 50000       // edges not followed by an element within this time are discarded (glitches)
+
+/*
+ * called from the GPIO interrupt of the paddles (falling edge: contact closed)
+ * @param gpio: GPIO that triggered the interrupt
+ * @param events: GPIO_IRQ_EDGE_FALL and/or GPIO_IRQ_EDGE_RISE
+ */
+void latency_stats_edge(uint gpio, uint32_t events);
+
+/*
+ * arms the edge detection. Called while the keyer is idle and both paddles are released
+ */
+void latency_stats_arm();
+
+/*
+ * disarms the edge detection and drops a pending edge. Called if the keyer leaves the idle state for
+ * anything else than a paddle element (e.g. text received through the serial port)
+ */
+void latency_stats_disarm();
+
+/*
+ * called when the keyer leaves the idle state because a paddle is pressed
+ */
+void latency_stats_element_start();
+
+/*
+ * called when the first packet containing the tone of the started element is passed to the USB stack. In the
+ * deferred mode it only marks the packet as rendered, see latency_stats_take_tone_rendered()
+ */
+void latency_stats_tone_sent();
+
+/*
+ * enables the deferred mode used if packets are rendered ahead of the USB stream: the measurement is finished
+ * by latency_stats_packet_sent() when the packet rendered with the tone is passed to the USB stack
+ * @param defer: true to enable the deferred mode
+ */
+void latency_stats_defer(bool defer);
+
+/*
+ * returns and clears the mark set by latency_stats_tone_sent() in the deferred mode. Called by the renderer
+ * after each packet to tag the packets carrying the first tone of an element
+ * @return true if the tone of a measured element was rendered into the last packet
+ */
+bool latency_stats_take_tone_rendered();
+
+/*
+ * finishes a deferred measurement. Called when a packet tagged by latency_stats_take_tone_rendered() is
+ * passed to the USB stack
+ */
+void latency_stats_packet_sent();
+
+/*
+ * clears the histogram
+ */
+void latency_stats_reset();
+
+/*
+ * writes a human readable report of the histogram (count, min, max, mean, percentiles, buckets)
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t latency_stats_report(char *buf, uint32_t maxsize);
+
+#endif
@@ -0,0 +1,166 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "led_health.h"
+
+#include "led_service.h"
+
+/*
+ * LED mode showing CPU load, text buffer fill level and underruns. led_health_enable() is called by the parser on
+ * core 0, it only stores the request. The keyer core applies it in led_health_task() and owns all other state
+ */
+
+static volatile bool enable_requested = false;      // health mode requested by led_health_enable() (core 0)
+static bool enabled = false;                        // health mode enabled (keyer core)
+static uint32_t work_start;                         // timestamp [us] of the beginning of the current audio work
+static uint32_t frame_busy;                         // time [us] spent for audio work in the current frame
+static uint32_t window_max_busy;                    // maximum busy time [us] of a frame in the current update period
+static uint32_t window_underruns;                   // missed frames in the current update period
+static uint32_t last_frame;                         // timestamp [us] of the beginning of the last frame
+static bool last_frame_valid = false;
+static uint32_t last_update;                        // timestamp [us] of the last LED update
+static uint32_t last_underrun;                      // timestamp [us] of the last update period with underruns
+static bool underrun_shown = false;                 // an underrun happened within LED_HEALTH_UNDERRUN_HOLD_US
+static bool flash_on = false;
+
+/*
+ * requests to enable or disable the health mode, applied by the next led_health_task()
+ * @param enable: true to show the health of the keyer
+ */
+void led_health_enable(bool enable) {
+    enable_requested = enable;
+}
+
+/*
+ * applies a request of led_health_enable() and starts a new window (keyer core)
+ */
+static void apply_enable() {
+    enabled = enable_requested;
+    frame_busy = 0;
+    window_max_busy = 0;
+    window_underruns = 0;
+    last_frame_valid = false;
+    underrun_shown = false;
+    led_service_show_diagnostics(enabled);
+}
+
+/*
+ * called at the beginning of each audio frame
+ */
+void __not_in_flash_func(led_health_frame)() {
+    if (!enabled) {
+        return;
+    }
+
+    uint32_t now = time_us_32();
+    if (last_frame_valid) {
+        uint32_t gap = now - last_frame;
+        if ((gap > LED_HEALTH_FRAME_US * 3 / 2) && (gap < LED_HEALTH_STREAM_TIMEOUT_US)) {
+            window_underruns += (gap + LED_HEALTH_FRAME_US / 2) / LED_HEALTH_FRAME_US - 1;
+        }
+    }
+    last_frame = now;
+    last_frame_valid = true;
+
+    window_max_busy = frame_busy > window_max_busy ? frame_busy : window_max_busy;
+    frame_busy = 0;
+}
+
+/*
+ * marks the beginning of the audio work within a frame
+ */
+void __not_in_flash_func(led_health_work_begin)() {
+    work_start = time_us_32();
+}
+
+/*
+ * marks the end of the audio work within a frame
+ */
+void __not_in_flash_func(led_health_work_end)() {
+    if (enabled) {
+        frame_busy += time_us_32() - work_start;
+    }
+}
+
+/*
+ * adds underruns detected outside of the frame timing
+ * @param count: number of underruns
+ */
+void led_health_underruns(uint32_t count) {
+    if (enabled) {
+        window_underruns += count;
+    }
+}
+
+/*
+ * updates the LED every LED_HEALTH_PERIOD_US if the health mode is enabled
+ * @param queue_level: number of characters in the text buffer
+ * @param queue_size: size of the text buffer
+ */
+void led_health_task(uint32_t queue_level, uint32_t queue_size) {
+    if (enable_requested != enabled) {
+        apply_enable();
+    }
+
+    uint32_t now = time_us_32();
+    if (!enabled || (now - last_update < LED_HEALTH_PERIOD_US)) {
+        return;
+    }
+    last_update = now;
+
+    if (window_underruns > 0) {
+        last_underrun = now;
+        underrun_shown = true;
+    } else if (underrun_shown && (now - last_underrun > LED_HEALTH_UNDERRUN_HOLD_US)) {
+        underrun_shown = false;
+    }
+
+    uint32_t load = window_max_busy * 100 / LED_HEALTH_FRAME_US;       // [%] of a frame
+    uint32_t brightness = LED_HEALTH_MIN_BRIGHTNESS + (queue_size > 0 ? queue_level * (255 - LED_HEALTH_MIN_BRIGHTNESS) / queue_size : 0);
+    uint32_t r;
+    uint32_t g;
+    uint32_t b = 0;
+
+    if (underrun_shown) {
+        flash_on = !flash_on;
+        r = flash_on ? 255 : 0;
+        g = 0;
+        b = flash_on ? 255 : 0;
+        brightness = 255;
+    } else {
+        // green -> yellow at 50% -> red at 100%
+        load = load > 100 ? 100 : load;
+        r = load < 50 ? load * 255 / 50 : 255;
+        g = load < 50 ? 255 : (100 - load) * 255 / 50;
+    }
+
+    r = r * brightness / 255;
+    g = g * brightness / 255;
+    b = b * brightness / 255;
+    led_service_set_diagnostics((r << 8) | (g << 16) | b);
+
+    window_max_busy = 0;
+    window_underruns = 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef _LED_HEALTH_H_
+#define _LED_HEALTH_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "pico/stdlib.h"
+
+/*
+ * optional LED mode showing the health of the keyer. A low-rate task in the loop of the keyer core encodes:
+ * - the CPU load of the busiest audio frame in the colour (green: idle, yellow: 50%, red: >= 100% of a frame)
+ * - the fill level of the text buffer in the brightness (dim: empty, full brightness: full)
+ * - recent audio underruns (missed USB frames or packets not rendered in time) by flashing magenta
+ */
+
+#define LED_HEALTH_PERIOD_US 100000         // update period of the LED
+#define LED_HEALTH_FRAME_US 1000            // length of an audio frame
+#define LED_HEALTH_STREAM_TIMEOUT_US 50000  // gaps between frames longer than this are a stopped stream, not underruns
+#define LED_HEALTH_UNDERRUN_HOLD_US 2000000 // time an underrun is shown
+#define LED_HEALTH_MIN_BRIGHTNESS 16        // brightness with an empty text buffer [0, 255]
+
+/*
+ * enables or disables the health mode. While enabled, the colours of the keyer are not shown. May be called from
+ * the other core, the change takes effect with the next led_health_task()
+ * @param enable: true to show the health of the keyer
+ */
+void led_health_enable(bool enable);
+
+/*
+ * called at the beginning of each audio frame (rendering of a packet)
+ */
+void led_health_frame();
+
+/*
+ * marks the beginning of the audio work within a frame
+ */
+void led_health_work_begin();
+
+/*
+ * marks the end of the audio work within a frame
+ */
+void led_health_work_end();
+
+/*
+ * adds underruns detected outside of the frame timing (e.g. the USB stream found no rendered packet)
+ * @param count: number of underruns
+ */
+void led_health_underruns(uint32_t count);
+
+/*
+ * updates the LED every LED_HEALTH_PERIOD_US if the health mode is enabled. Called from the loop of the keyer core
+ * @param queue_level: number of characters in the text buffer
+ * @param queue_size: size of the text buffer
+ */
+void led_health_task(uint32_t queue_level, uint32_t queue_size);
+
+#endif
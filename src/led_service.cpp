@@ -0,0 +1,99 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "led_service.h"
+
+#include "hardware/dma.h"
+
+/*
+ * non-blocking, change-only driver of the NeoPixel LED
+ */
+
+static int dma_channel = -1;                        // DMA channel feeding the WS2812 state machine
+static uint32_t tx_word;                            // word read by the DMA (colour << 8)
+static uint32_t shown_color;                        // last colour sent to the LED
+static volatile uint32_t keyer_color;               // colour requested by led_service_set()
+static volatile uint32_t diagnostics_color;         // colour requested by led_service_set_diagnostics()
+static volatile bool diagnostics = false;           // show the diagnostics colour instead of the keyer colour
+
+/*
+ * claims a DMA channel feeding the TX FIFO of the WS2812 state machine
+ * @param pio: PIO running the WS2812 program
+ * @param sm: state machine running the WS2812 program
+ */
+void led_service_init(PIO pio, uint sm) {
+    dma_channel = dma_claim_unused_channel(true);
+
+    dma_channel_config config = dma_channel_get_default_config(dma_channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+    channel_config_set_read_increment(&config, false);
+    channel_config_set_write_increment(&config, false);
+    channel_config_set_dreq(&config, pio_get_dreq(pio, sm, true));
+    dma_channel_configure(dma_channel, &config, &pio->txf[sm], &tx_word, 1, false);
+
+    // force the first colour to be sent
+    shown_color = ~0u;
+    keyer_color = 0;
+}
+
+/*
+ * requests a new colour
+ * @param pixel_grb: color of the Neopixel LED (r << 8 | g << 16 | b)
+ */
+void __not_in_flash_func(led_service_set)(uint32_t pixel_grb) {
+    keyer_color = pixel_grb;
+}
+
+/*
+ * switches between the colours requested by the keyer and the colours of a diagnostics mode
+ * @param enabled: true to show the diagnostics colours
+ */
+void led_service_show_diagnostics(bool enabled) {
+    diagnostics_color = 0;
+    diagnostics = enabled;
+}
+
+/*
+ * requests a new colour of the diagnostics mode
+ * @param pixel_grb: color of the Neopixel LED (r << 8 | g << 16 | b)
+ */
+void led_service_set_diagnostics(uint32_t pixel_grb) {
+    diagnostics_color = pixel_grb;
+}
+
+/*
+ * sends the colour of the active source if it differs from the colour shown and the DMA channel is idle
+ */
+void led_service_task() {
+    uint32_t color = diagnostics ? diagnostics_color : keyer_color;
+
+    if ((color == shown_color) || dma_channel_is_busy(dma_channel)) {
+        return;                                     // nothing to do or sent by the next call
+    }
+
+    tx_word = color << 8u;
+    dma_channel_set_read_addr(dma_channel, &tx_word, true);
+    shown_color = color;
+}
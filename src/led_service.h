@@ -0,0 +1,74 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef _LED_SERVICE_H_
+#define _LED_SERVICE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+
+/*
+ * non-blocking driver of the NeoPixel (WS2812) LED. The setters only store the requested colour and may be
+ * called from any core. led_service_task() sends the colour if it differs from the colour shown, using a
+ * one-shot DMA transfer into the TX FIFO of the WS2812 state machine, so the DMA channel is only used by
+ * the core calling led_service_task() and nobody waits for the PIO.
+ */
+
+/*
+ * claims a DMA channel feeding the TX FIFO of the WS2812 state machine
+ * @param pio: PIO running the WS2812 program
+ * @param sm: state machine running the WS2812 program
+ */
+void led_service_init(PIO pio, uint sm);
+
+/*
+ * requests a new colour. Returns immediately, the colour is sent by led_service_task()
+ * @param pixel_grb: color of the Neopixel LED (r << 8 | g << 16 | b)
+ */
+void led_service_set(uint32_t pixel_grb);
+
+/*
+ * switches between the colours requested by the keyer (led_service_set()) and the colours of a diagnostics
+ * mode (led_service_set_diagnostics())
+ * @param enabled: true to show the diagnostics colours
+ */
+void led_service_show_diagnostics(bool enabled);
+
+/*
+ * requests a new colour of the diagnostics mode. Shown while the diagnostics mode is enabled
+ * @param pixel_grb: color of the Neopixel LED (r << 8 | g << 16 | b)
+ */
+void led_service_set_diagnostics(uint32_t pixel_grb);
+
+/*
+ * sends the colour of the active source if it differs from the colour shown and the DMA channel is idle.
+ * Called from the loop of the keyer core
+ */
+void led_service_task();
+
+#endif
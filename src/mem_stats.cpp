@@ -0,0 +1,141 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "mem_stats.h"
+
+#include <malloc.h>
+#include <cstring>
+
+/*
+ * reports the RAM usage of stacks, heap and subsystems
+ */
+
+extern uint32_t __StackBottom;              // defined by the pico-sdk linker script
+extern uint32_t __StackTop;
+extern uint32_t __StackOneBottom;
+extern uint32_t __StackOneTop;
+extern char __scratch_x_start__;            // data placed in the scratch banks (__scratch_x(), __scratch_y())
+extern char __scratch_x_end__;
+extern char __scratch_y_start__;
+extern char __scratch_y_end__;
+extern char __end__;                        // start of the heap
+extern char __StackLimit;                   // end of the heap
+
+// entry of the allocation table
+typedef struct {
+    const char *name;                       // name of the subsystem
+    uint32_t bytes;                         // number of allocated bytes
+} mem_subsystem_t;
+
+static mem_subsystem_t subsystems[MEM_STATS_MAX_SUBSYSTEMS];
+static uint32_t nr_subsystems = 0;
+
+/*
+ * fills a stack region with the paint pattern
+ */
+static void paint(uint32_t *bottom, uint32_t *top) {
+    while (bottom < top) {
+        *bottom++ = MEM_STATS_PAINT;
+    }
+}
+
+/*
+ * returns the number of used bytes of a painted stack (the stack grows downwards)
+ */
+static uint32_t stack_used(uint32_t *bottom, uint32_t *top) {
+    uint32_t *p = bottom;
+    while ((p < top) && (*p == MEM_STATS_PAINT)) {
+        p++;
+    }
+    return (top - p) * sizeof(uint32_t);
+}
+
+/*
+ * paints the unused stack of core 0 and the stack of core 1
+ */
+void mem_stats_init() {
+    uint32_t marker;
+
+    // leave a margin below the current stack pointer for this function
+    paint(&__StackBottom, &marker - 16);
+    paint(&__StackOneBottom, &__StackOneTop);
+}
+
+/*
+ * adds memory allocated by a subsystem to the allocation table
+ * @param subsystem: name of the subsystem (the pointer is stored, use a string literal)
+ * @param bytes: number of allocated bytes
+ */
+void mem_stats_account(const char *subsystem, uint32_t bytes) {
+    for (uint32_t i = 0; i < nr_subsystems; i++) {
+        if (strcmp(subsystems[i].name, subsystem) == 0) {
+            subsystems[i].bytes += bytes;
+            return;
+        }
+    }
+
+    if (nr_subsystems < MEM_STATS_MAX_SUBSYSTEMS) {
+        subsystems[nr_subsystems].name = subsystem;
+        subsystems[nr_subsystems].bytes = bytes;
+        nr_subsystems++;
+    }
+}
+
+/*
+ * writes a human readable report of stack, heap and allocation table
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t mem_stats_report(char *buf, uint32_t maxsize) {
+    struct mallinfo mi = mallinfo();
+    uint32_t heap_size = &__StackLimit - &__end__;
+    uint32_t len;
+
+    len = snprintf(buf, maxsize, "stack core0 used=%lu/%lu core1 used=%lu/%lu\n",
+                   (unsigned long)stack_used(&__StackBottom, &__StackTop),
+                   (unsigned long)((&__StackTop - &__StackBottom) * sizeof(uint32_t)),
+                   (unsigned long)stack_used(&__StackOneBottom, &__StackOneTop),
+                   (unsigned long)((&__StackOneTop - &__StackOneBottom) * sizeof(uint32_t)));
+
+    if (len < maxsize) {
+        len += snprintf(buf + len, maxsize - len, "scratch_x data=%lu scratch_y data=%lu\n",
+                        (unsigned long)(&__scratch_x_end__ - &__scratch_x_start__),
+                        (unsigned long)(&__scratch_y_end__ - &__scratch_y_start__));
+    }
+
+    // arena is the memory taken from the heap by malloc so far, it never shrinks (high-water mark)
+    if (len < maxsize) {
+        len += snprintf(buf + len, maxsize - len, "heap used=%lu peak=%lu free=%lu size=%lu\n",
+                        (unsigned long)mi.uordblks, (unsigned long)mi.arena,
+                        (unsigned long)(heap_size - mi.arena + mi.fordblks), (unsigned long)heap_size);
+    }
+
+    for (uint32_t i = 0; (i < nr_subsystems) && (len < maxsize); i++) {
+        len += snprintf(buf + len, maxsize - len, "%s: %lu\n", subsystems[i].name, (unsigned long)subsystems[i].bytes);
+    }
+
+    return len < maxsize ? len : maxsize - 1;
+}
@@ -0,0 +1,63 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef _MEM_STATS_H_
+#define _MEM_STATS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "pico/stdlib.h"
+
+/*
+ * reports the RAM usage: stack high-water marks of both cores (based on stack painting at boot),
+ * heap usage and high-water mark and a table of the memory allocated by each subsystem
+ */
+
+#define MEM_STATS_PAINT 0x5A5A5A5A          // pattern written to the unused stack at boot
+#define MEM_STATS_MAX_SUBSYSTEMS 16         // maximum number of entries in the allocation table
+
+/*
+ * paints the unused stack of core 0 and the stack of core 1. Must be called at the beginning of
+ * main() before core 1 is launched
+ */
+void mem_stats_init();
+
+/*
+ * adds memory allocated by a subsystem to the allocation table
+ * @param subsystem: name of the subsystem (the pointer is stored, use a string literal)
+ * @param bytes: number of allocated bytes
+ */
+void mem_stats_account(const char *subsystem, uint32_t bytes);
+
+/*
+ * writes a human readable report of stack, heap and allocation table
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t mem_stats_report(char *buf, uint32_t maxsize);
+
+#endif
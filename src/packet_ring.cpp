@@ -0,0 +1,112 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "packet_ring.h"
+
+#include "hardware/sync.h"
+
+/*
+ * lock-free SPSC ring of audio packets
+ */
+
+/*
+ * initializes an empty ring
+ * @param ring: ring to be initialized
+ * @param storage: buffer of PACKET_RING_MAX_SLOTS * packet_size samples
+ * @param packet_size: number of samples of a packet
+ * @param depth: number of packets rendered ahead [1, PACKET_RING_MAX_SLOTS]
+ */
+void packet_ring_init(packet_ring_t *ring, int16_t *storage, uint32_t packet_size, uint32_t depth) {
+    ring->storage = storage;
+    ring->packet_size = packet_size;
+    ring->head = 0;
+    ring->tail = 0;
+    packet_ring_set_depth(ring, depth);
+}
+
+/*
+ * changes the number of packets rendered ahead
+ * @param ring: packet ring
+ * @param depth: number of packets rendered ahead, limited to [1, PACKET_RING_MAX_SLOTS]
+ * @return depth in use
+ */
+uint32_t packet_ring_set_depth(packet_ring_t *ring, uint32_t depth) {
+    ring->depth = depth < 1 ? 1 : (depth > PACKET_RING_MAX_SLOTS ? PACKET_RING_MAX_SLOTS : depth);
+    return ring->depth;
+}
+
+/*
+ * returns the slot for the next packet (producer)
+ * @param ring: packet ring
+ * @return packet buffer or NULL if depth packets are waiting
+ */
+int16_t *__not_in_flash_func(packet_ring_write_slot)(packet_ring_t *ring) {
+    uint32_t head = ring->head;
+    if (head - ring->tail >= ring->depth) {
+        return NULL;
+    }
+    return ring->storage + (head % PACKET_RING_MAX_SLOTS) * ring->packet_size;
+}
+
+/*
+ * publishes the packet written to the slot returned by packet_ring_write_slot() (producer)
+ * @param ring: packet ring
+ */
+void __not_in_flash_func(packet_ring_commit)(packet_ring_t *ring) {
+    __dmb();                                // packet data is visible before the new head
+    ring->head = ring->head + 1;
+}
+
+/*
+ * returns the oldest packet (consumer)
+ * @param ring: packet ring
+ * @return packet or NULL if the ring is empty
+ */
+const int16_t *__not_in_flash_func(packet_ring_read_slot)(packet_ring_t *ring) {
+    uint32_t tail = ring->tail;
+    if (ring->head == tail) {
+        return NULL;
+    }
+    __dmb();                                // packet data is read after the head
+    return ring->storage + (tail % PACKET_RING_MAX_SLOTS) * ring->packet_size;
+}
+
+/*
+ * frees the packet returned by packet_ring_read_slot() (consumer)
+ * @param ring: packet ring
+ */
+void __not_in_flash_func(packet_ring_release)(packet_ring_t *ring) {
+    __dmb();                                // packet data is read before the slot is handed back
+    ring->tail = ring->tail + 1;
+}
+
+/*
+ * returns the number of packets waiting in the ring
+ * @param ring: packet ring
+ * @return number of committed and not yet released packets
+ */
+uint32_t packet_ring_level(packet_ring_t *ring) {
+    return ring->head - ring->tail;
+}
@@ -0,0 +1,103 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef _PACKET_RING_H_
+#define _PACKET_RING_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "pico/stdlib.h"
+
+/*
+ * lock-free single producer, single consumer ring of audio packets. The producer (keyer core) renders into
+ * the slot returned by packet_ring_write_slot() and publishes it with packet_ring_commit(), the consumer
+ * (USB core) reads the oldest packet with packet_ring_read_slot() and frees it with packet_ring_release().
+ * Each index is only written by one side, memory barriers order the packet data and the index updates.
+ * The depth may be changed at any time from either side, the slot of a packet does not depend on the depth.
+ */
+
+#define PACKET_RING_MAX_SLOTS 8             // maximum number of packets in the ring
+
+typedef struct {
+    int16_t *storage;                       // PACKET_RING_MAX_SLOTS packets of packet_size samples
+    uint32_t packet_size;                   // number of samples of a packet
+    volatile uint32_t depth;                // number of packets rendered ahead [1, PACKET_RING_MAX_SLOTS]
+    volatile uint32_t head;                 // number of committed packets, written by the producer
+    volatile uint32_t tail;                 // number of released packets, written by the consumer
+} packet_ring_t;
+
+/*
+ * initializes an empty ring
+ * @param ring: ring to be initialized
+ * @param storage: buffer of PACKET_RING_MAX_SLOTS * packet_size samples
+ * @param packet_size: number of samples of a packet
+ * @param depth: number of packets rendered ahead [1, PACKET_RING_MAX_SLOTS]
+ */
+void packet_ring_init(packet_ring_t *ring, int16_t *storage, uint32_t packet_size, uint32_t depth);
+
+/*
+ * changes the number of packets rendered ahead. A smaller depth takes effect once the consumer has drained
+ * the ring below the new depth, a larger depth with the next packet
+ * @param ring: packet ring
+ * @param depth: number of packets rendered ahead, limited to [1, PACKET_RING_MAX_SLOTS]
+ * @return depth in use
+ */
+uint32_t packet_ring_set_depth(packet_ring_t *ring, uint32_t depth);
+
+/*
+ * returns the slot for the next packet (producer)
+ * @param ring: packet ring
+ * @return packet buffer or NULL if depth packets are waiting
+ */
+int16_t *packet_ring_write_slot(packet_ring_t *ring);
+
+/*
+ * publishes the packet written to the slot returned by packet_ring_write_slot() (producer)
+ * @param ring: packet ring
+ */
+void packet_ring_commit(packet_ring_t *ring);
+
+/*
+ * returns the oldest packet (consumer)
+ * @param ring: packet ring
+ * @return packet or NULL if the ring is empty
+ */
+const int16_t *packet_ring_read_slot(packet_ring_t *ring);
+
+/*
+ * frees the packet returned by packet_ring_read_slot() (consumer)
+ * @param ring: packet ring
+ */
+void packet_ring_release(packet_ring_t *ring);
+
+/*
+ * returns the number of packets waiting in the ring
+ * @param ring: packet ring
+ * @return number of committed and not yet released packets
+ */
+uint32_t packet_ring_level(packet_ring_t *ring);
+
+#endif
@@ -0,0 +1,129 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "paddle_capture.h"
+
+#include "hardware/gpio.h"
+#include "mem_stats.h"
+
+/*
+ * records the raw paddle edges with a timestamp in the GPIO interrupt
+ * each edge is stored as: bits 31..2 time since the start of the capture [us], bit 1 paddle (0: DIT, 1: DAH),
+ * bit 0 level (1: pressed)
+ */
+
+static uint32_t edges[PADDLE_CAPTURE_MAX_EDGES];    // captured edges
+static volatile uint32_t nr_edges = 0;              // number of captured edges
+static volatile bool running = false;               // capture is running
+static bool overflow = false;                       // capture was stopped because the buffer was full or the time elapsed
+static uint32_t start_time;                         // timestamp [us] of the start of the capture
+static uint16_t capture_wpm;                        // speed at the start of the capture
+static uint capture_dit_gpio;
+static uint capture_dah_gpio;
+
+/*
+ * initializes the capture
+ * @param dit_gpio: GPIO of the DIT paddle
+ * @param dah_gpio: GPIO of the DAH paddle
+ */
+void paddle_capture_init(uint dit_gpio, uint dah_gpio) {
+    capture_dit_gpio = dit_gpio;
+    capture_dah_gpio = dah_gpio;
+    mem_stats_account("paddle capture", sizeof(edges));
+}
+
+/*
+ * called from the GPIO interrupt of the paddles. Records the edge while a capture is running
+ * @param gpio: GPIO that triggered the interrupt
+ * @param events: GPIO_IRQ_EDGE_FALL and/or GPIO_IRQ_EDGE_RISE
+ */
+void __not_in_flash_func(paddle_capture_edge)(uint gpio, uint32_t events) {
+    if (!running || ((gpio != capture_dit_gpio) && (gpio != capture_dah_gpio))) {
+        return;
+    }
+
+    uint32_t t = time_us_32() - start_time;
+    if ((nr_edges >= PADDLE_CAPTURE_MAX_EDGES) || (t >= PADDLE_CAPTURE_MAX_TIME)) {
+        running = false;
+        overflow = true;
+        return;
+    }
+
+    // paddles are active low. If both edges are reported the contact bounced faster than the interrupt latency
+    bool pressed;
+    if ((events & (GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE)) == GPIO_IRQ_EDGE_FALL) {
+        pressed = true;
+    } else if ((events & (GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE)) == GPIO_IRQ_EDGE_RISE) {
+        pressed = false;
+    } else {
+        pressed = !gpio_get(gpio);
+    }
+
+    edges[nr_edges] = (t << 2) | ((gpio == capture_dah_gpio) ? 2 : 0) | (pressed ? 1 : 0);
+    nr_edges = nr_edges + 1;
+}
+
+/*
+ * clears the buffer and starts a new capture
+ * @param wpm: current speed, stored in the header of the dump
+ */
+void paddle_capture_start(uint16_t wpm) {
+    running = false;
+    nr_edges = 0;
+    overflow = false;
+    capture_wpm = wpm;
+    start_time = time_us_32();
+    running = true;
+}
+
+/*
+ * stops the capture
+ */
+void paddle_capture_stop() {
+    running = false;
+}
+
+/*
+ * writes one page of the capture as text
+ * @param page: page number, each page contains PADDLE_CAPTURE_DUMP_LINES edges
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t paddle_capture_dump(uint32_t page, char *buf, uint32_t maxsize) {
+    uint32_t count = nr_edges;
+    uint32_t pages = (count + PADDLE_CAPTURE_DUMP_LINES - 1) / PADDLE_CAPTURE_DUMP_LINES;
+    uint32_t len;
+
+    len = snprintf(buf, maxsize, "# paddle capture edges=%lu wpm=%u page=%lu/%lu %s\n", (unsigned long)count, capture_wpm,
+                   (unsigned long)page, (unsigned long)pages, running ? "running" : (overflow ? "full" : "stopped"));
+
+    for (uint32_t i = page * PADDLE_CAPTURE_DUMP_LINES; (i < count) && (i < (page + 1) * PADDLE_CAPTURE_DUMP_LINES) && (len < maxsize); i++) {
+        len += snprintf(buf + len, maxsize - len, "%lu %s %s\n", (unsigned long)(edges[i] >> 2),
+                        (edges[i] & 2) ? "dah" : "dit", (edges[i] & 1) ? "down" : "up");
+    }
+
+    return len < maxsize ? len : maxsize - 1;
+}
@@ -0,0 +1,81 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef _PADDLE_CAPTURE_H_
+#define _PADDLE_CAPTURE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "pico/stdlib.h"
+
+/*
+ * records the raw (not debounced) paddle edges with a timestamp in the GPIO interrupt. The dump is
+ * the capture format read by the host tool host/tools/paddle_replay.cpp: lines "<time_us> <dit|dah> <down|up>"
+ * with the time relative to the start of the capture, '#' starts a comment. The pages of a dump can be
+ * concatenated to a capture file.
+ */
+
+#define PADDLE_CAPTURE_MAX_EDGES 2048       // size of the capture buffer (4 bytes per edge)
+#define PADDLE_CAPTURE_MAX_TIME (1u << 30)  // maximum capture duration [us] (~17 minutes)
+#define PADDLE_CAPTURE_DUMP_LINES 20        // number of edges returned per dump page
+
+/*
+ * initializes the capture
+ * @param dit_gpio: GPIO of the DIT paddle
+ * @param dah_gpio: GPIO of the DAH paddle
+ */
+void paddle_capture_init(uint dit_gpio, uint dah_gpio);
+
+/*
+ * called from the GPIO interrupt of the paddles. Records the edge while a capture is running
+ * @param gpio: GPIO that triggered the interrupt
+ * @param events: GPIO_IRQ_EDGE_FALL and/or GPIO_IRQ_EDGE_RISE
+ */
+void paddle_capture_edge(uint gpio, uint32_t events);
+
+/*
+ * clears the buffer and starts a new capture. The capture stops automatically if the buffer is full
+ * or PADDLE_CAPTURE_MAX_TIME has elapsed
+ * @param wpm: current speed, stored in the header of the dump
+ */
+void paddle_capture_start(uint16_t wpm);
+
+/*
+ * stops the capture
+ */
+void paddle_capture_stop();
+
+/*
+ * writes one page of the capture as text. The first line is a comment with the number of edges, the
+ * speed and the state of the capture, followed by one line per edge
+ * @param page: page number, each page contains PADDLE_CAPTURE_DUMP_LINES edges
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t paddle_capture_dump(uint32_t page, char *buf, uint32_t maxsize);
+
+#endif
@@ -0,0 +1,263 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "pc_profiler.h"
+
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+
+/*
+ * statistical profiler sampling the interrupted program counter from a repeating hardware alarm per core.
+ * The alarm interrupt of a core is enabled only in the NVIC of that core, so each handler samples its own
+ * core into its own histogram and the counters are never written by both cores.
+ */
+
+extern char __flash_binary_start;           // defined by the pico-sdk linker script
+extern char __flash_binary_end;
+
+#define ROM_BASE 0x00000000
+#define ROM_SIZE 0x4000
+#define RAM_BASE 0x20000000
+#define RAM_SIZE 0x42000
+
+// address region covered by the histogram
+typedef struct {
+    const char *name;                       // name shown in the dump
+    uint32_t base;                          // start address of the region
+    uint32_t size;                          // size of the region in bytes
+    uint32_t first_bucket;                  // index of the first bucket of this region in the histogram
+    uint32_t nr_buckets;                    // number of buckets reserved for this region
+    uint32_t shift;                         // log2 of the bucket size
+} pc_region_t;
+
+static pc_region_t regions[] = {
+    {"rom", ROM_BASE, ROM_SIZE, 0, PC_PROFILER_ROM_BUCKETS, 0},
+    {"flash", 0, 0, PC_PROFILER_ROM_BUCKETS, PC_PROFILER_FLASH_BUCKETS, 0},
+    {"ram", RAM_BASE, RAM_SIZE, PC_PROFILER_ROM_BUCKETS + PC_PROFILER_FLASH_BUCKETS, PC_PROFILER_RAM_BUCKETS, 0}
+};
+#define NR_REGIONS (sizeof(regions) / sizeof(regions[0]))
+#define NR_BUCKETS (PC_PROFILER_ROM_BUCKETS + PC_PROFILER_FLASH_BUCKETS + PC_PROFILER_RAM_BUCKETS)
+
+#define NR_CORES 2
+
+static uint16_t hist[NR_CORES][NR_BUCKETS]; // saturating sample counters of each core
+static uint32_t samples_total[NR_CORES];    // number of samples taken on each core
+static uint32_t samples_other[NR_CORES];    // samples outside of all regions
+static bool regions_initialized = false;
+static volatile bool running = false;
+static int alarm_num[NR_CORES] = {-1, -1};  // hardware alarm sampling each core
+static uint32_t period_us;                  // sample period
+static uint32_t next_alarm[NR_CORES];       // time of the next sample of each core
+
+/*
+ * records a single sample of the interrupted core. Called from the alarm interrupt with the stacked program counter
+ * @param pc: program counter of the interrupted code
+ */
+extern "C" void __not_in_flash_func(pc_profiler_sample)(uint32_t pc) {
+    uint32_t core = get_core_num();
+    uint32_t alarm = alarm_num[core];
+
+    hw_clear_bits(&timer_hw->intr, 1u << alarm);
+
+    if (running) {
+        next_alarm[core] += period_us;
+        if ((int32_t)(next_alarm[core] - timer_hw->timerawl) < 2) {
+            next_alarm[core] = timer_hw->timerawl + period_us;  // missed samples (e.g. interrupts disabled), resynchronise
+        }
+        timer_hw->alarm[alarm] = next_alarm[core];
+    }
+
+    samples_total[core]++;
+    for (uint32_t i = 0; i < NR_REGIONS; i++) {
+        uint32_t offs = pc - regions[i].base;
+        if (offs < regions[i].size) {
+            uint16_t *counter = &hist[core][regions[i].first_bucket + (offs >> regions[i].shift)];
+            if (*counter != UINT16_MAX) {
+                (*counter)++;
+            }
+            return;
+        }
+    }
+    samples_other[core]++;
+}
+
+/*
+ * alarm interrupt handler. Reads the program counter from the exception stack frame
+ * (r0, r1, r2, r3, r12, lr, pc, xpsr) and passes it to pc_profiler_sample()
+ */
+static void __attribute__((naked)) __not_in_flash_func(pc_profiler_irq_handler)() {
+    __asm volatile (
+        "movs r0, #4            \n"
+        "mov r1, lr             \n"
+        "tst r0, r1             \n"         // EXC_RETURN bit 2: frame on MSP or PSP
+        "beq 1f                 \n"
+        "mrs r0, psp            \n"
+        "b 2f                   \n"
+        "1:                     \n"
+        "mrs r0, msp            \n"
+        "2:                     \n"
+        "ldr r0, [r0, #24]      \n"         // stacked pc
+        "ldr r1, 3f             \n"
+        "bx r1                  \n"         // tail call, pc_profiler_sample returns from the exception
+        ".align 2               \n"
+        "3:                     \n"
+        ".word pc_profiler_sample\n"
+    );
+}
+
+/*
+ * calculates the bucket size of each region
+ */
+static void pc_profiler_init_regions() {
+    regions[1].base = (uint32_t)&__flash_binary_start;
+    regions[1].size = (uint32_t)(&__flash_binary_end - &__flash_binary_start);
+
+    for (uint32_t i = 0; i < NR_REGIONS; i++) {
+        regions[i].shift = PC_PROFILER_MIN_SHIFT;
+        while ((regions[i].size >> regions[i].shift) >= regions[i].nr_buckets) {
+            regions[i].shift++;
+        }
+    }
+    regions_initialized = true;
+}
+
+/*
+ * claims the hardware alarm sampling the calling core and enables its interrupt on this core. Must be called
+ * once on each core to be profiled, on core 0 before core 1 is launched. The alarm stays disarmed until
+ * pc_profiler_start()
+ */
+void pc_profiler_init_core() {
+    uint32_t core = get_core_num();
+
+    if (!regions_initialized) {
+        pc_profiler_init_regions();
+    }
+    if (alarm_num[core] >= 0) {
+        return;
+    }
+
+    alarm_num[core] = hardware_alarm_claim_unused(true);
+    uint irq_num = TIMER_IRQ_0 + alarm_num[core];
+    irq_set_exclusive_handler(irq_num, pc_profiler_irq_handler);
+    irq_set_priority(irq_num, PICO_HIGHEST_IRQ_PRIORITY);           // allow sampling of other interrupt handlers
+    hw_set_bits(&timer_hw->inte, 1u << alarm_num[core]);
+    irq_set_enabled(irq_num, true);                                 // NVIC of the calling core only
+}
+
+/*
+ * starts sampling with the given rate. The histogram is not cleared
+ * @param rate: sample rate in Hz [1, PC_PROFILER_MAX_RATE]
+ */
+void pc_profiler_start(uint32_t rate) {
+    rate = rate < 1 ? 1 : rate;
+    rate = rate > PC_PROFILER_MAX_RATE ? PC_PROFILER_MAX_RATE : rate;
+    period_us = 1000000 / rate;
+
+    uint32_t save = save_and_disable_interrupts();
+    running = true;
+    for (uint32_t core = 0; core < NR_CORES; core++) {
+        if (alarm_num[core] >= 0) {
+            // the cores are sampled half a period apart, so their handlers do not compete for the bus
+            next_alarm[core] = timer_hw->timerawl + period_us + core * (period_us / 2);
+            timer_hw->alarm[alarm_num[core]] = next_alarm[core];
+        }
+    }
+    restore_interrupts(save);
+}
+
+/*
+ * stops sampling
+ */
+void pc_profiler_stop() {
+    running = false;
+    for (uint32_t core = 0; core < NR_CORES; core++) {
+        if (alarm_num[core] >= 0) {
+            timer_hw->armed = 1u << alarm_num[core];                // disarm a pending alarm
+            hw_clear_bits(&timer_hw->intr, 1u << alarm_num[core]);
+        }
+    }
+}
+
+/*
+ * clears the histograms of both cores
+ */
+void pc_profiler_clear() {
+    uint32_t save = save_and_disable_interrupts();
+    for (uint32_t core = 0; core < NR_CORES; core++) {
+        for (uint32_t i = 0; i < NR_BUCKETS; i++) {
+            hist[core][i] = 0;
+        }
+        samples_total[core] = 0;
+        samples_other[core] = 0;
+    }
+    restore_interrupts(save);
+}
+
+/*
+ * writes one page of the histogram as text
+ * @param page: page number, each page contains PC_PROFILER_DUMP_LINES buckets
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t pc_profiler_dump(uint32_t page, char *buf, uint32_t maxsize) {
+    uint32_t len;
+    uint32_t nonempty = 0;
+
+    for (uint32_t i = 0; i < NR_BUCKETS; i++) {
+        nonempty += (hist[0][i] > 0) || (hist[1][i] > 0) ? 1 : 0;
+    }
+    uint32_t pages = (nonempty + PC_PROFILER_DUMP_LINES - 1) / PC_PROFILER_DUMP_LINES;
+
+    len = snprintf(buf, maxsize, "pcprof samples=%lu/%lu other=%lu/%lu page=%lu/%lu",
+                   (unsigned long)samples_total[0], (unsigned long)samples_total[1],
+                   (unsigned long)samples_other[0], (unsigned long)samples_other[1],
+                   (unsigned long)page, (unsigned long)pages);
+    for (uint32_t r = 0; (r < NR_REGIONS) && (len < maxsize); r++) {
+        len += snprintf(buf + len, maxsize - len, " %s=%u", regions[r].name, 1u << regions[r].shift);
+    }
+    if (len < maxsize) {
+        len += snprintf(buf + len, maxsize - len, "\n");
+    }
+
+    uint32_t entry = 0;
+    for (uint32_t r = 0; r < NR_REGIONS; r++) {
+        for (uint32_t b = 0; (b < regions[r].nr_buckets) && (len < maxsize); b++) {
+            uint16_t count0 = hist[0][regions[r].first_bucket + b];
+            uint16_t count1 = hist[1][regions[r].first_bucket + b];
+            if ((count0 == 0) && (count1 == 0)) {
+                continue;
+            }
+            if ((entry / PC_PROFILER_DUMP_LINES) == page) {
+                len += snprintf(buf + len, maxsize - len, "%08lx %u %u\n",
+                                (unsigned long)(regions[r].base + (b << regions[r].shift)), count0, count1);
+            }
+            entry++;
+        }
+    }
+
+    return len < maxsize ? len : maxsize - 1;
+}
@@ -0,0 +1,84 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef _PC_PROFILER_H_
+#define _PC_PROFILER_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "pico/stdlib.h"
+
+/*
+ * statistical profiler sampling the interrupted program counter from a repeating hardware alarm.
+ * Each core has its own alarm, enabled only in the interrupt controller of that core, and its own
+ * histogram, so the USB and parser code on core 0 and the rendering on core 1 are sampled and reported
+ * separately. The samples are collected in a histogram keyed by address bucket for the boot ROM
+ * (soft-float and memory routines), the flash image and the SRAM (time critical code). The dump can be
+ * symbolised on the host using tools/pcprof_symbolize.py and the ELF file of the firmware.
+ */
+
+#define PC_PROFILER_DEFAULT_RATE 1000       // default sample rate of each core in Hz
+#define PC_PROFILER_MAX_RATE 25500          // maximum sample rate in Hz
+#define PC_PROFILER_ROM_BUCKETS 64          // number of buckets for the boot ROM
+#define PC_PROFILER_RAM_BUCKETS 256         // number of buckets for the SRAM
+#define PC_PROFILER_FLASH_BUCKETS 1728      // number of buckets for the flash image
+#define PC_PROFILER_MIN_SHIFT 4             // minimum bucket size is 2^4 = 16 bytes
+#define PC_PROFILER_DUMP_LINES 24           // number of buckets returned per dump page
+
+/*
+ * claims the hardware alarm sampling the calling core and enables its interrupt on this core. Called once on
+ * each core, on core 0 before core 1 is launched. A core that did not call it is not sampled
+ */
+void pc_profiler_init_core();
+
+/*
+ * starts sampling both cores with the given rate. The histograms are not cleared
+ * @param rate: sample rate in Hz [1, PC_PROFILER_MAX_RATE]
+ */
+void pc_profiler_start(uint32_t rate);
+
+/*
+ * stops sampling
+ */
+void pc_profiler_stop();
+
+/*
+ * clears the histograms of both cores
+ */
+void pc_profiler_clear();
+
+/*
+ * writes one page of the histograms as text. The first line contains the number of samples of core 0 and
+ * core 1 and the bucket sizes, followed by one line "<address> <count core 0> <count core 1>" for each
+ * bucket of the page that is non-empty on either core.
+ * @param page: page number, each page contains PC_PROFILER_DUMP_LINES buckets
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t pc_profiler_dump(uint32_t page, char *buf, uint32_t maxsize);
+
+#endif
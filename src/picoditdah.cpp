@@ -28,68 +28,200 @@
 #include <stdlib.h>
 
 #include "../button-debouncer/button_debounce.h"
+#include "boot_stats.h"
 #include "cw_generator.h"
+#include "keyer_core.h"
+#include "mem_stats.h"
+#include "pc_profiler.h"
+#include "power_manager.h"
+#include "scheduler.h"
+#include "self_benchmark.h"
+#include "trainer.h"
 #include "winkeyer_parser.h"
 #include "pico/malloc.h"
 #include "pico/stdlib.h"
 #include "pico/util/queue.h"
 #include "usb_devices.h"
 
-CWGenerator *cwgen;
-WinKeyerParser *wkparser;
+#define CDC_BUFFER_SIZE 512                 // size of the CDC receive buffer, also holds the replies (e.g. statistic reports)
+#define USB_TASK_DEADLINE_US 1000           // TinyUSB events are handled within one USB frame
+#define CDC_TASK_DEADLINE_US 2000           // a WinKeyer message is parsed within two USB frames
 
-void on_usb_microphone_tx_pre() {
-    // write the prepared audio buffer to USB
-    usb_microphone_write(cwgen->get_audio_buffer(), cwgen->get_audio_buffer_size());
-}
+#ifndef RADIO1_KEY_GPIO
+#define RADIO1_KEY_GPIO -1                  // keying output of radio 1 (WinKeyer key out 1), -1: none
+#endif
+#ifndef RADIO2_KEY_GPIO
+#define RADIO2_KEY_GPIO -1                  // keying output of radio 2 (WinKeyer key out 2), -1: none
+#endif
+
+PicoCWGenerator *cwgen;                     // generator of radio 1
+PicoCWGenerator *cwgens[KEYER_MAX_GENERATORS];
+WinKeyerParser *wkparser;
+static scheduler_t usb_scheduler;           // tasks of core 0
+static volatile bool usb_suspended = false; // USB bus suspended, applied by power_task()
 
-void on_usb_microphone_tx_post() {
-    // calculate next buffer
-    cwgen->update_statemachine();
+void __not_in_flash_func(on_usb_microphone_tx_pre)() {
+    // write the packet rendered by the keyer core to USB, the generators belong to core 1
+    usb_microphone_write(keyer_core_read_packet(), sizeof(int16_t) * SAMPLE_BUFFER_SIZE);
+    keyer_core_release_packet();
 }
 
 void on_usb_microphone_volume(uint8_t channel, uint16_t volume, bool mute) {
+    (void)mute;                             // the sidetone level follows the volume only
     if (channel == 0) {
-        cwgen->set_volume(volume);
+        for (uint32_t i = 0; i < KEYER_MAX_GENERATORS; i++) {
+            cwgens[i]->set_volume(volume);
+        }
     }
 }
 
+void on_usb_suspend(bool suspended) {
+    usb_suspended = suspended;
+}
+
+void on_usb_mount() {
+    boot_stats_mark(BOOT_ENUMERATED);
+}
+
+/*
+ * runs the self-benchmark on the generator of radio 1, rendered through the same path as on core 1
+ * @param iterations: calls per kernel, 0: SELF_BENCHMARK_DEFAULT_ITERATIONS
+ */
+static uint32_t on_benchmark(uint32_t iterations, char *buf, uint32_t maxsize) {
+    return self_benchmark_run(cwgen, wkparser, iterations > 0 ? iterations : SELF_BENCHMARK_DEFAULT_ITERATIONS, buf, maxsize);
+}
+
+/*
+ * recomputes the PIO dividers after the power manager changed the system clock
+ */
+static void on_clock_change() {
+    if (cwgen != NULL) {
+        cwgen->update_clock_dividers();     // the paddle debouncer and the LED are shared by all generators
+    }
+}
+
+
+/*
+ * write a reply to the serial port. Replies larger than the CDC FIFO are sent in several chunks
+ * @param buf: data to be sent
+ * @param count: number of bytes to be sent
+ */
+static void cdc_write(uint8_t *buf, uint32_t count) {
+    while ((count > 0) && tud_cdc_n_connected(0)) {
+        uint32_t written = tud_cdc_n_write(0, buf, count);
+        tud_cdc_n_write_flush(0);
+
+        buf += written;
+        count -= written;
+        if (written == 0) {
+            usb_devices_task();                 // FIFO is full, let TinyUSB transmit it
+        }
+    }
+}
 
 /*
  * check serial port for new messages and parse them accordingly
  */
 static void cdc_task(void) {
     if (tud_cdc_n_available(0) > 0) {
-        uint8_t buf[64];
-        uint32_t count = tud_cdc_n_read(0, buf, sizeof(buf));
+        uint8_t buf[CDC_BUFFER_SIZE];
+        power_manager_activity();               // the message may start a character
+        uint32_t count = tud_cdc_n_read(0, buf, 64);
 
         // interpret message as WinKeyer message
-        count = wkparser->parse_message(buf, count, 64);
+        count = wkparser->parse_message(buf, count, sizeof(buf));
 
         if (count > 0) {
-            tud_cdc_n_write(0, buf, count);
-            tud_cdc_n_write_flush(0);
+            cdc_write(buf, count);
         }
     }
 }
 
+/*
+ * ready function of the serial port task
+ * @return true if data was received
+ */
+static bool cdc_ready(void) {
+    return tud_cdc_n_available(0) > 0;
+}
+
+/*
+ * parks the keyer core and lowers the clock while the bus is suspended, scales the clock with the keyer activity
+ */
+static void power_task(void) {
+    if (usb_suspended && !power_manager_is_suspended()) {
+        keyer_core_pause();
+        power_manager_suspend(true);
+    } else if (!usb_suspended && power_manager_is_suspended()) {
+        power_manager_suspend(false);
+        keyer_core_resume();
+    }
+
+    bool busy = trainer_is_running();             // the pile-up is rendered at the active clock
+    for (uint32_t i = 0; i < KEYER_MAX_GENERATORS; i++) {
+        busy = busy || cwgens[i]->is_busy();
+    }
+    power_manager_task(!busy);
+}
+
 int main() {
+    boot_stats_mark(BOOT_MAIN);
+    mem_stats_init();
+    power_manager_init(on_clock_change);
+
+    // connect to the host first, so its debounce and reset of the port run in parallel to the remaining
+    // initialization. USB events are handled by usb_devices_task(), so no callback runs before the main loop
+    usb_devices_init();
+    boot_stats_mark(BOOT_USB_CONNECTED);
+
     stdio_init_all();
 
     printf("PicoDitDah v0.1\n");
-    cwgen = new CWGenerator(SAMPLE_RATE, SAMPLE_BUFFER_SIZE);
+    // the generators (one per radio) and their audio buffers are statically allocated, they are constructed here
+    // after the memory statistics and stdio are initialized. The keyshape table and the LED are not needed before
+    // the first keyed element, they are initialized by core 1 while core 0 services the enumeration
+    static PicoCWGenerator cwgen_instances[KEYER_MAX_GENERATORS] = {PicoCWGenerator(true), PicoCWGenerator(true)};
+    static const int key_gpios[KEYER_MAX_GENERATORS] = {RADIO1_KEY_GPIO, RADIO2_KEY_GPIO};
+    for (uint32_t i = 0; i < KEYER_MAX_GENERATORS; i++) {
+        cwgens[i] = &cwgen_instances[i];
+        cwgens[i]->set_key_gpio(key_gpios[i]);
+        cwgens[i]->set_paddles(i == 0);     // the paddles key the radio selected by the pin configuration
+    }
+    cwgen = cwgens[0];
     wkparser = new WinKeyerParser(cwgen);
+    for (uint32_t i = 1; i < KEYER_MAX_GENERATORS; i++) {
+        wkparser->set_generator(i, cwgens[i]);
+    }
+    mem_stats_account("cwgen static", sizeof(cwgen_instances));
+    mem_stats_account("wkparser", sizeof(WinKeyerParser));
 
     printf("audio_buffer_size: %u\n", cwgen->get_audio_buffer_size());
 
-    usb_devices_init();
+    // keyer, rendering and LED on core 1, USB and the parser on core 0. Core 1 claims its profiler alarm itself
+    pc_profiler_init_core();
+    keyer_core_launch(cwgens, KEYER_MAX_GENERATORS);
+    wkparser->set_render_ahead_handler(keyer_core_set_depth);
+    wkparser->set_benchmark_handler(on_benchmark);
+    wkparser->set_trainer_handler(keyer_core_trainer);
+
     usb_microphone_set_tx_pre_handler(on_usb_microphone_tx_pre);
-    usb_microphone_set_tx_post_handler(on_usb_microphone_tx_post);
     usb_microphone_set_volume_handler(on_usb_microphone_volume);
+    usb_microphone_set_stream_handler(keyer_core_stream);
+    usb_devices_set_suspend_handler(on_usb_suspend);
+    usb_devices_set_mount_handler(on_usb_mount);
+
+    // USB servicing, the serial port and the clock wake-up are polled, the power management is periodic, all
+    // earliest deadline first. Without work core 0 sleeps until the next USB interrupt or the next power task
+    scheduler_init(&usb_scheduler, "core0");
+    scheduler_add(&usb_scheduler, "usb", usb_devices_task, usb_devices_task_ready, 0, USB_TASK_DEADLINE_US);
+    scheduler_add(&usb_scheduler, "cdc", cdc_task, cdc_ready, 0, CDC_TASK_DEADLINE_US);
+    scheduler_add(&usb_scheduler, "power", power_task, NULL, POWER_TASK_PERIOD_US, POWER_TASK_PERIOD_US);
+    scheduler_add(&usb_scheduler, "wake", power_manager_wake_task, power_manager_wake_requested, 0, POWER_WAKE_DEADLINE_US);
 
+    boot_stats_mark(BOOT_LOOP);
     while (1) {
-        // run the USB microphone task continuously
-        usb_devices_task();
-        cdc_task();
+        if (!scheduler_run_once(&usb_scheduler)) {
+            power_manager_sleep(scheduler_next_release_us(&usb_scheduler));
+        }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,310 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "power_manager.h"
+
+#include "hardware/clocks.h"
+#include "hardware/pll.h"
+#include "hardware/structs/scb.h"
+#include "hardware/sync.h"
+#include "pico/platform.h"
+
+/*
+ * clock scaling, sleep and wake-up statistics
+ */
+
+enum {
+    POWER_LEVEL_ACTIVE,
+    POWER_LEVEL_IDLE,
+    POWER_LEVEL_SUSPEND,
+    POWER_LEVELS
+};
+
+static const char *level_names[POWER_LEVELS] = {"active", "idle", "suspend"};
+
+// clocks of the peripherals PicoDitDah does not use, gated while the bus is suspended (same bits in WAKE_EN and SLEEP_EN)
+#define SUSPEND_GATED_EN0 (CLOCKS_WAKE_EN0_CLK_SYS_SPI0_BITS | CLOCKS_WAKE_EN0_CLK_PERI_SPI0_BITS | \
+                           CLOCKS_WAKE_EN0_CLK_SYS_SPI1_BITS | CLOCKS_WAKE_EN0_CLK_PERI_SPI1_BITS | \
+                           CLOCKS_WAKE_EN0_CLK_SYS_I2C0_BITS | CLOCKS_WAKE_EN0_CLK_SYS_I2C1_BITS | \
+                           CLOCKS_WAKE_EN0_CLK_SYS_ADC_BITS | CLOCKS_WAKE_EN0_CLK_ADC_ADC_BITS | \
+                           CLOCKS_WAKE_EN0_CLK_SYS_PWM_BITS | CLOCKS_WAKE_EN0_CLK_SYS_RTC_BITS | \
+                           CLOCKS_WAKE_EN0_CLK_RTC_RTC_BITS | CLOCKS_WAKE_EN0_CLK_SYS_JTAG_BITS)
+#define SUSPEND_GATED_EN1 (CLOCKS_WAKE_EN1_CLK_SYS_UART1_BITS | CLOCKS_WAKE_EN1_CLK_PERI_UART1_BITS)
+
+static power_clock_handler_t clock_handler = NULL;
+static uint32_t active_hz;                          // clk_sys at boot
+static uint vco_freq, post_div1, post_div2;         // PLL_SYS settings of the active frequency
+static volatile uint32_t level = POWER_LEVEL_ACTIVE;
+static volatile uint32_t idle_since;                // last time the keyer was busy
+
+static uint64_t stats_since;                        // start of the statistics
+static uint64_t level_since;                        // time the current level was entered
+static uint64_t residency_us[POWER_LEVELS];         // time spent at each level
+static volatile uint64_t sleep_time_us[2];          // time each core slept in power_manager_sleep()
+
+static volatile uint32_t wake_start;                // time of the activity that requested the wake-up
+static volatile bool wake_requested = false;        // power_manager_activity() found the idle clock
+static bool wake_pending = false;                   // waiting for the first tone after a wake-up
+static uint32_t wake_count;                         // number of wake-ups from the idle clock
+static uint32_t wake_clock_max_us;                  // longest time to raise the clock
+static uint32_t wake_sample_last_us;                // wake-up to first tone packet of the last wake-up
+static uint32_t wake_sample_max_us;                 // longest wake-up to first tone packet
+
+/*
+ * gates the clocks of the unused peripherals while awake and asleep, or enables all clocks again
+ * @param gated: true to stop the clocks of SUSPEND_GATED_EN0/1
+ */
+static void gate_unused_clocks(bool gated) {
+    clocks_hw->wake_en0 = gated ? CLOCKS_WAKE_EN0_BITS & ~SUSPEND_GATED_EN0 : CLOCKS_WAKE_EN0_BITS;
+    clocks_hw->wake_en1 = gated ? CLOCKS_WAKE_EN1_BITS & ~SUSPEND_GATED_EN1 : CLOCKS_WAKE_EN1_BITS;
+    clocks_hw->sleep_en0 = gated ? CLOCKS_SLEEP_EN0_BITS & ~SUSPEND_GATED_EN0 : CLOCKS_SLEEP_EN0_BITS;
+    clocks_hw->sleep_en1 = gated ? CLOCKS_SLEEP_EN1_BITS & ~SUSPEND_GATED_EN1 : CLOCKS_SLEEP_EN1_BITS;
+}
+
+/*
+ * switches clk_sys and recomputes the PIO dividers
+ * @param new_level: POWER_LEVEL_ACTIVE, POWER_LEVEL_IDLE or POWER_LEVEL_SUSPEND
+ */
+static void set_level(uint32_t new_level) {
+    uint32_t irq = save_and_disable_interrupts();
+    if (new_level == level) {
+        restore_interrupts(irq);
+        return;
+    }
+
+    uint64_t now = time_us_64();
+    residency_us[level] += now - level_since;
+    level_since = now;
+
+    if (new_level == POWER_LEVEL_ACTIVE) {
+        if (level == POWER_LEVEL_SUSPEND) {
+            gate_unused_clocks(false);
+            pll_init(pll_sys, 1, vco_freq, post_div1, post_div2);
+        }
+        clock_configure(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX, CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS,
+                        active_hz, active_hz);
+    } else {
+        // clk_sys stays at 48 MHz from PLL_USB while suspended, the USB controller is accessed with clk_sys and
+        // clk_sys must not run slower than clk_usb
+        clock_configure(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX, CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB,
+                        POWER_IDLE_KHZ * 1000, POWER_IDLE_KHZ * 1000);
+        if (new_level == POWER_LEVEL_SUSPEND) {
+            pll_deinit(pll_sys);
+            gate_unused_clocks(true);
+        }
+    }
+    level = new_level;
+
+    if (clock_handler != NULL) {
+        clock_handler();
+    }
+    restore_interrupts(irq);
+}
+
+/*
+ * moves clk_peri to PLL_USB and stores the boot frequency of clk_sys as active frequency
+ * @param handler: called after every change of clk_sys
+ */
+void power_manager_init(power_clock_handler_t handler) {
+    clock_handler = handler;
+    active_hz = clock_get_hz(clk_sys);
+    check_sys_clock_khz(active_hz / 1000, &vco_freq, &post_div1, &post_div2);
+
+    // the UART keeps its baud rate when clk_sys changes
+    clock_configure(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB, 48 * MHZ, 48 * MHZ);
+
+    level = POWER_LEVEL_ACTIVE;
+    idle_since = time_us_32();
+    power_manager_reset();
+}
+
+/*
+ * requests the active clock if the keyer is about to key (both cores, also from interrupts)
+ */
+void __not_in_flash_func(power_manager_activity)() {
+    idle_since = time_us_32();
+    if ((level != POWER_LEVEL_IDLE) || wake_requested) {
+        return;                                     // already active or requested, or suspended until the bus resumes
+    }
+
+    wake_start = time_us_32();
+    wake_requested = true;
+    __sev();                                        // wake core 0 to raise the clock
+}
+
+/*
+ * returns if power_manager_activity() requested the active clock
+ * @return true until power_manager_wake_task() ran
+ */
+bool __not_in_flash_func(power_manager_wake_requested)() {
+    return wake_requested;
+}
+
+/*
+ * raises the clock requested by power_manager_activity() (core 0)
+ */
+void power_manager_wake_task() {
+    wake_requested = false;
+    if (level != POWER_LEVEL_IDLE) {
+        return;                                     // raised by power_manager_task() or suspended meanwhile
+    }
+
+    set_level(POWER_LEVEL_ACTIVE);
+    uint32_t elapsed = time_us_32() - wake_start;
+    if (elapsed > wake_clock_max_us) {
+        wake_clock_max_us = elapsed;
+    }
+    wake_count++;
+    wake_pending = true;
+}
+
+/*
+ * lowers the clock once the keyer has been idle for POWER_IDLE_DELAY_US (core 0)
+ * @param keyer_idle: no character is queued or sent and the paddles are released
+ */
+void power_manager_task(bool keyer_idle) {
+    uint32_t now = time_us_32();
+
+    if (level == POWER_LEVEL_SUSPEND) {
+        return;
+    }
+    if (!keyer_idle) {
+        idle_since = now;
+        set_level(POWER_LEVEL_ACTIVE);
+    } else if ((level == POWER_LEVEL_ACTIVE) && (now - idle_since >= POWER_IDLE_DELAY_US)) {
+        set_level(POWER_LEVEL_IDLE);
+    }
+}
+
+/*
+ * enters or leaves the suspend clock (core 0)
+ * @param suspended: true if the USB bus is suspended
+ */
+void power_manager_suspend(bool suspended) {
+    if (suspended) {
+        set_level(POWER_LEVEL_SUSPEND);
+    } else {
+        set_level(POWER_LEVEL_ACTIVE);
+        idle_since = time_us_32();
+    }
+}
+
+/*
+ * returns if the suspend clock is active
+ * @return true between power_manager_suspend(true) and power_manager_suspend(false)
+ */
+bool power_manager_is_suspended() {
+    return level == POWER_LEVEL_SUSPEND;
+}
+
+/*
+ * sleeps until an event or interrupt, at most max_us
+ * @param max_us: maximum sleep time, UINT32_MAX: until the next event
+ */
+void __not_in_flash_func(power_manager_sleep)(uint32_t max_us) {
+    if (max_us == 0) {
+        return;
+    }
+
+    // an interrupt becoming pending sets the event register, so WFE returns at once if one arrived after the
+    // caller checked for work
+    scb_hw->scr |= M0PLUS_SCR_SEVONPEND_BITS;
+
+    uint32_t start = time_us_32();
+    if (max_us == UINT32_MAX) {
+        __wfe();
+    } else {
+        best_effort_wfe_or_timeout(make_timeout_time_us(max_us));
+    }
+    sleep_time_us[get_core_num()] += time_us_32() - start;
+}
+
+/*
+ * finishes the wake-to-first-sample measurement if the clock was raised for this element
+ */
+void __not_in_flash_func(power_manager_tone_sent)() {
+    if (!wake_pending) {
+        return;
+    }
+
+    wake_sample_last_us = time_us_32() - wake_start;
+    if (wake_sample_last_us > wake_sample_max_us) {
+        wake_sample_max_us = wake_sample_last_us;
+    }
+    wake_pending = false;
+}
+
+/*
+ * clears the residency, sleep and wake statistics
+ */
+void power_manager_reset() {
+    uint64_t now = time_us_64();
+
+    stats_since = now;
+    level_since = now;
+    for (uint32_t i = 0; i < POWER_LEVELS; i++) {
+        residency_us[i] = 0;
+    }
+    sleep_time_us[0] = 0;
+    sleep_time_us[1] = 0;
+    wake_count = 0;
+    wake_clock_max_us = 0;
+    wake_sample_last_us = 0;
+    wake_sample_max_us = 0;
+}
+
+/*
+ * writes a human readable report of clock, residency, sleep time and wake-up times
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t power_manager_report(char *buf, uint32_t maxsize) {
+    uint64_t now = time_us_64();
+    uint64_t residency[POWER_LEVELS];
+
+    for (uint32_t i = 0; i < POWER_LEVELS; i++) {
+        residency[i] = residency_us[i] + (i == level ? now - level_since : 0);
+    }
+
+    uint32_t len = snprintf(buf, maxsize, "power clock=%lu kHz level=%s\n", (unsigned long)(clock_get_hz(clk_sys) / 1000),
+                            level_names[level]);
+    if (len < maxsize) {
+        len += snprintf(buf + len, maxsize - len, "residency active=%lu idle=%lu suspend=%lu ms\n",
+                        (unsigned long)(residency[POWER_LEVEL_ACTIVE] / 1000), (unsigned long)(residency[POWER_LEVEL_IDLE] / 1000),
+                        (unsigned long)(residency[POWER_LEVEL_SUSPEND] / 1000));
+    }
+    if (len < maxsize) {
+        len += snprintf(buf + len, maxsize - len, "sleep core0=%lu core1=%lu of %lu ms\n", (unsigned long)(sleep_time_us[0] / 1000),
+                        (unsigned long)(sleep_time_us[1] / 1000), (unsigned long)((now - stats_since) / 1000));
+    }
+    if (len < maxsize) {
+        len += snprintf(buf + len, maxsize - len, "wake n=%lu clock max=%lu us first sample last=%lu max=%lu us\n",
+                        (unsigned long)wake_count, (unsigned long)wake_clock_max_us, (unsigned long)wake_sample_last_us,
+                        (unsigned long)wake_sample_max_us);
+    }
+
+    return len < maxsize ? len : maxsize - 1;
+}
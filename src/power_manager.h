@@ -0,0 +1,124 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef _POWER_MANAGER_H_
+#define _POWER_MANAGER_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "pico/stdlib.h"
+
+/*
+ * scales the system clock with the keyer activity and puts the cores to sleep between events.
+ * active: clk_sys from PLL_SYS at the boot frequency
+ * idle: clk_sys from PLL_USB (48 MHz) after the keyer was idle for POWER_IDLE_DELAY_US, PLL_SYS keeps running so
+ *       the clock is raised within a few cycles after a paddle edge or a serial message
+ * suspend: clk_sys from PLL_USB (48 MHz, not below clk_usb), PLL_SYS stopped and the clocks of the unused
+ *          peripherals (SPI, I2C, ADC, PWM, RTC, JTAG, UART1) gated while the USB bus is suspended
+ * clk_peri is moved to PLL_USB so the UART does not depend on clk_sys. After every change of clk_sys the clock
+ * handler recomputes the PIO dividers. All clock changes are made on core 0: a paddle edge or a serial message only
+ * requests the active clock, the wake task raises it.
+ */
+
+#define POWER_IDLE_KHZ 48000                // clk_sys while the keyer is idle or the bus is suspended
+#define POWER_IDLE_DELAY_US 500000          // keyer idle time until the clock is lowered
+#define POWER_TASK_PERIOD_US 10000          // period of power_manager_task()
+#define POWER_WAKE_DEADLINE_US 100          // deadline of power_manager_wake_task() after a wake-up request
+
+typedef void (*power_clock_handler_t)(void);
+
+/*
+ * moves clk_peri to PLL_USB and stores the boot frequency of clk_sys as active frequency. Must be called at
+ * the beginning of main() before the UART is initialized
+ * @param handler: called after every change of clk_sys
+ */
+void power_manager_init(power_clock_handler_t handler);
+
+/*
+ * requests the active clock if the keyer is about to key, e.g. on a paddle edge or a serial message. Only sets a
+ * flag and wakes core 0 (both cores, also from interrupts)
+ */
+void power_manager_activity();
+
+/*
+ * ready function of the wake task
+ * @return true if power_manager_activity() requested the active clock
+ */
+bool power_manager_wake_requested();
+
+/*
+ * raises the clock to the active frequency after power_manager_activity(). Polled task of core 0 with the
+ * ready function power_manager_wake_requested() and the deadline POWER_WAKE_DEADLINE_US
+ */
+void power_manager_wake_task();
+
+/*
+ * lowers the clock once the keyer has been idle for POWER_IDLE_DELAY_US and raises it if the keyer became
+ * busy without power_manager_activity(). Called every POWER_TASK_PERIOD_US (core 0)
+ * @param keyer_idle: no character is queued or sent and the paddles are released
+ */
+void power_manager_task(bool keyer_idle);
+
+/*
+ * enters or leaves the suspend clock (core 0)
+ * @param suspended: true if the USB bus is suspended
+ */
+void power_manager_suspend(bool suspended);
+
+/*
+ * returns if the suspend clock is active
+ * @return true between power_manager_suspend(true) and power_manager_suspend(false)
+ */
+bool power_manager_is_suspended();
+
+/*
+ * sleeps until an event or interrupt, at most max_us. Pending interrupts wake the core, so an interrupt
+ * arriving between the check for work and the sleep is not lost
+ * @param max_us: maximum sleep time, UINT32_MAX: until the next event
+ */
+void power_manager_sleep(uint32_t max_us);
+
+/*
+ * called when the first packet with a tone is passed to the USB stack, finishes the wake-to-first-sample
+ * measurement if the clock was raised for this element
+ */
+void power_manager_tone_sent();
+
+/*
+ * clears the residency, sleep and wake statistics
+ */
+void power_manager_reset();
+
+/*
+ * writes a human readable report: current clock, time spent at each clock, sleep time of both cores and
+ * the wake-up times
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t power_manager_report(char *buf, uint32_t maxsize);
+
+#endif
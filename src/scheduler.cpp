@@ -0,0 +1,201 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "scheduler.h"
+
+/*
+ * cooperative EDF scheduler, times are compared as signed differences so the 32 bit microsecond timer may wrap
+ */
+
+static scheduler_t *instances[SCHEDULER_MAX_INSTANCES];
+static uint32_t instance_count = 0;
+
+/*
+ * initializes a scheduler without tasks and adds it to the report
+ * @param sched: scheduler to be initialized
+ * @param name: name shown in the report
+ */
+void scheduler_init(scheduler_t *sched, const char *name) {
+    sched->name = name;
+    sched->count = 0;
+
+    if (instance_count < SCHEDULER_MAX_INSTANCES) {
+        instances[instance_count] = sched;
+        instance_count++;
+    }
+}
+
+/*
+ * adds a task, periodic tasks are released for the first time when they are added
+ * @param sched: scheduler
+ * @param name: name shown in the report
+ * @param run: work of the task
+ * @param ready: returns true if a polled task has work (NULL: always released), ignored for periodic tasks
+ * @param period_us: release period, 0 for a polled task
+ * @param deadline_us: deadline relative to the release
+ * @return false if the task table is full
+ */
+bool scheduler_add(scheduler_t *sched, const char *name, scheduler_task_fn_t run, scheduler_ready_fn_t ready,
+                   uint32_t period_us, uint32_t deadline_us) {
+    if (sched->count >= SCHEDULER_MAX_TASKS) {
+        return false;
+    }
+
+    scheduler_task_t *task = &sched->tasks[sched->count];
+    task->name = name;
+    task->run = run;
+    task->ready = ready;
+    task->period_us = period_us;
+    task->deadline_us = deadline_us;
+    task->release = time_us_32();
+    task->waiting = false;
+    task->runs = 0;
+    task->overruns = 0;
+    task->max_us = 0;
+    sched->count++;
+    return true;
+}
+
+/*
+ * runs the released task with the earliest deadline
+ * @param sched: scheduler
+ * @return false if no task was released
+ */
+bool __not_in_flash_func(scheduler_run_once)(scheduler_t *sched) {
+    uint32_t now = time_us_32();
+    scheduler_task_t *next = NULL;
+    uint32_t next_deadline = 0;
+
+    for (uint32_t i = 0; i < sched->count; i++) {
+        scheduler_task_t *task = &sched->tasks[i];
+        if ((task->period_us > 0) && ((int32_t)(now - task->release) < 0)) {
+            continue;                               // not released yet
+        }
+        if (task->period_us == 0) {
+            if ((task->ready != NULL) && !task->ready()) {
+                task->waiting = false;
+                continue;                           // nothing to do
+            }
+            if (!task->waiting) {
+                task->release = now;                // released when first found ready, ages until it runs
+                task->waiting = true;
+            }
+        }
+
+        uint32_t deadline = task->release + task->deadline_us;
+        if ((next == NULL) || ((int32_t)(deadline - next_deadline) < 0)) {
+            next = task;
+            next_deadline = deadline;
+        }
+    }
+
+    if (next == NULL) {
+        return false;
+    }
+
+    uint32_t start = time_us_32();
+    next->run();
+    uint32_t end = time_us_32();
+
+    next->runs = next->runs + 1;
+    if (end - start > next->max_us) {
+        next->max_us = end - start;
+    }
+    if ((int32_t)(end - next_deadline) > 0) {
+        next->overruns = next->overruns + 1;
+    }
+
+    if (next->period_us == 0) {
+        next->waiting = false;
+    } else {
+        next->release += next->period_us;
+        if ((int32_t)(end - (next->release + next->deadline_us)) > 0) {
+            next->release = end;                    // the next job would be late as well, skip the missed periods
+        }
+    }
+    return true;
+}
+
+/*
+ * returns the time until the next periodic task is released
+ * @param sched: scheduler
+ * @return time until the next release [us], 0 if a periodic task is already released, UINT32_MAX without periodic tasks
+ */
+uint32_t __not_in_flash_func(scheduler_next_release_us)(scheduler_t *sched) {
+    uint32_t now = time_us_32();
+    uint32_t next = UINT32_MAX;
+
+    for (uint32_t i = 0; i < sched->count; i++) {
+        scheduler_task_t *task = &sched->tasks[i];
+        if (task->period_us == 0) {
+            continue;
+        }
+
+        int32_t delta = (int32_t)(task->release - now);
+        if (delta <= 0) {
+            return 0;
+        }
+        if ((uint32_t)delta < next) {
+            next = delta;
+        }
+    }
+    return next;
+}
+
+/*
+ * clears the run and overrun counters of all schedulers
+ */
+void scheduler_reset_stats() {
+    for (uint32_t i = 0; i < instance_count; i++) {
+        for (uint32_t t = 0; t < instances[i]->count; t++) {
+            scheduler_task_t *task = &instances[i]->tasks[t];
+            task->runs = 0;
+            task->overruns = 0;
+            task->max_us = 0;
+        }
+    }
+}
+
+/*
+ * writes a human readable report of the tasks of all schedulers
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t scheduler_report(char *buf, uint32_t maxsize) {
+    uint32_t len = snprintf(buf, maxsize, "scheduler instances=%lu\n", (unsigned long)instance_count);
+
+    for (uint32_t i = 0; (i < instance_count) && (len < maxsize); i++) {
+        scheduler_t *sched = instances[i];
+        for (uint32_t t = 0; (t < sched->count) && (len < maxsize); t++) {
+            scheduler_task_t *task = &sched->tasks[t];
+            len += snprintf(buf + len, maxsize - len, "%s %s period=%lu deadline=%lu runs=%lu overruns=%lu max=%lu us\n",
+                            sched->name, task->name, (unsigned long)task->period_us, (unsigned long)task->deadline_us,
+                            (unsigned long)task->runs, (unsigned long)task->overruns, (unsigned long)task->max_us);
+        }
+    }
+
+    return len < maxsize ? len : maxsize - 1;
+}
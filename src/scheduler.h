@@ -0,0 +1,125 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "pico/stdlib.h"
+
+/*
+ * cooperative earliest-deadline-first scheduler of stackless tasks. Each core runs its own scheduler, a task
+ * is a function that does a bounded piece of work and returns. Periodic tasks are released every period,
+ * polled tasks (period 0) whenever their ready function returns true (or on every pass without one). A polled
+ * task is released at the first pass it is found ready and keeps this release until it runs, so its deadline
+ * does not move while it waits. Of all released tasks the one with the earliest absolute deadline runs next.
+ * A task finishing after its deadline is counted as overrun. If no task is released, the core may sleep until the
+ * next periodic release or an interrupt makes a polled task ready.
+ *
+ * tasks of the firmware (added in picoditdah.cpp and keyer_core.cpp), deadlines relative to the release:
+ * core  task    period                        deadline                          ready function
+ * 0     usb     polled                        1 ms (USB_TASK_DEADLINE_US)       usb_devices_task_ready()
+ * 0     cdc     polled                        2 ms (CDC_TASK_DEADLINE_US)       cdc_ready()
+ * 0     power   10 ms (POWER_TASK_PERIOD_US)  10 ms (POWER_TASK_PERIOD_US)      -
+ * 0     wake    polled                        100 us (POWER_WAKE_DEADLINE_US)   power_manager_wake_requested()
+ * 1     render  polled                        1 ms (KEYER_RENDER_DEADLINE_US)   keyer_render_ready()
+ * 1     led     10 ms (KEYER_LED_PERIOD_US)   20 ms (KEYER_LED_DEADLINE_US)     -
+ */
+
+#define SCHEDULER_MAX_TASKS 8               // maximum number of tasks of a scheduler
+#define SCHEDULER_MAX_INSTANCES 2           // maximum number of schedulers (one per core)
+
+typedef void (*scheduler_task_fn_t)(void);
+typedef bool (*scheduler_ready_fn_t)(void);
+
+typedef struct {
+    const char *name;                       // name shown in the report (string literal)
+    scheduler_task_fn_t run;                // work of the task
+    scheduler_ready_fn_t ready;             // polled task has work, NULL: always
+    uint32_t period_us;                     // release period, 0: polled on every pass
+    uint32_t deadline_us;                   // deadline relative to the release
+    uint32_t release;                       // release time of the next job, of a polled task: when it became ready [us]
+    bool waiting;                           // polled task is ready and has not run since
+    volatile uint32_t runs;                 // number of finished jobs
+    volatile uint32_t overruns;             // number of jobs finished after their deadline
+    volatile uint32_t max_us;               // longest run time
+} scheduler_task_t;
+
+typedef struct {
+    const char *name;                       // name shown in the report (string literal)
+    scheduler_task_t tasks[SCHEDULER_MAX_TASKS];
+    uint32_t count;                         // number of added tasks
+} scheduler_t;
+
+/*
+ * initializes a scheduler without tasks and adds it to the report
+ * @param sched: scheduler to be initialized
+ * @param name: name shown in the report (the pointer is stored, use a string literal)
+ */
+void scheduler_init(scheduler_t *sched, const char *name);
+
+/*
+ * adds a task, periodic tasks are released for the first time when they are added
+ * @param sched: scheduler
+ * @param name: name shown in the report (the pointer is stored, use a string literal)
+ * @param run: work of the task
+ * @param ready: returns true if a polled task has work (NULL: always released), ignored for periodic tasks
+ * @param period_us: release period, 0 for a polled task
+ * @param deadline_us: deadline relative to the release
+ * @return false if the task table is full
+ */
+bool scheduler_add(scheduler_t *sched, const char *name, scheduler_task_fn_t run, scheduler_ready_fn_t ready,
+                   uint32_t period_us, uint32_t deadline_us);
+
+/*
+ * runs the released task with the earliest deadline
+ * @param sched: scheduler
+ * @return false if no task was released
+ */
+bool scheduler_run_once(scheduler_t *sched);
+
+/*
+ * returns the time until the next periodic task is released
+ * @param sched: scheduler
+ * @return time until the next release [us], 0 if a periodic task is already released, UINT32_MAX without periodic tasks
+ */
+uint32_t scheduler_next_release_us(scheduler_t *sched);
+
+/*
+ * clears the run and overrun counters of all schedulers
+ */
+void scheduler_reset_stats();
+
+/*
+ * writes a human readable report of the tasks of all schedulers
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t scheduler_report(char *buf, uint32_t maxsize);
+
+#endif
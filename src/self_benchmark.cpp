@@ -0,0 +1,424 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "self_benchmark.h"
+
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/structs/bus_ctrl.h"
+#include "hardware/structs/systick.h"
+#include "hardware/structs/xip_ctrl.h"
+#include "hardware/sync.h"
+#include "keyer_core.h"
+#include "pico/platform.h"
+#include "trainer.h"
+
+/*
+ * on-device benchmark of the hot kernels of the synthesis and the parser
+ */
+
+#define SYSTICK_MASK 0x00FFFFFF             // SysTick is a 24 bit down counter
+#define SYSTICK_CSR_RUN 0x5                 // enable, clocked by the processor clock
+#define DMA_LOAD_RING_BITS 8                // the DMA load wraps its write address every 2^8 bytes (all SRAM banks)
+#define BENCH_IRQ_WINDOW 100                // calls measured with interrupts disabled before pending interrupts are served
+
+// canned WinKeyer stream: host open is not included to keep the WinKeyer mode, speed change and text
+static const uint8_t WK_BENCH_STREAM[] = {
+    0x02, 25,                               // speed 25 WPM
+    'c', 'q', ' ', 'c', 'q', ' ', 'd', 'e', ' ', 'd', 'g', '1', 'p', 's', 'i', ' ', 'k'
+};
+
+// cycle statistics of a kernel
+typedef struct {
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t count;
+} bench_result_t;
+
+static uint32_t overhead;                   // cycles needed by the measurement itself
+static uint32_t saved_interrupts;           // interrupt state before bench_begin()
+static uint32_t saved_systick_csr;          // SysTick configuration before bench_begin()
+static uint32_t saved_systick_rvr;
+static uint32_t dma_load_word;              // source of the DMA load
+static uint32_t dma_load_buffer[(1 << DMA_LOAD_RING_BITS) / sizeof(uint32_t)] __attribute__((aligned(1 << DMA_LOAD_RING_BITS)));
+
+/*
+ * returns the current SysTick counter value
+ */
+static inline uint32_t cycles_now() {
+    return systick_hw->cvr;
+}
+
+/*
+ * returns the number of elapsed cycles between two SysTick values
+ */
+static inline uint32_t cycles_elapsed(uint32_t start, uint32_t end) {
+    uint32_t cycles = (start - end) & SYSTICK_MASK;
+    return cycles > overhead ? cycles - overhead : 0;
+}
+
+/*
+ * invalidates the XIP cache, so that every code or table access to flash is a cache miss
+ */
+static inline void flush_xip_cache() {
+    xip_ctrl_hw->flush = 1;
+    (void)xip_ctrl_hw->flush;               // the read blocks until the flush is finished
+}
+
+/*
+ * starts a DMA channel writing to the striped main SRAM with one word per cycle until dma_load_stop()
+ * @return DMA channel of the load
+ */
+static int dma_load_start() {
+    int channel = dma_claim_unused_channel(true);
+
+    dma_channel_config config = dma_channel_get_default_config(channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+    channel_config_set_read_increment(&config, false);
+    channel_config_set_write_increment(&config, true);
+    channel_config_set_ring(&config, true, DMA_LOAD_RING_BITS);
+    dma_channel_configure(channel, &config, dma_load_buffer, &dma_load_word, 0xFFFFFFFF, true);
+    return channel;
+}
+
+/*
+ * stops the DMA load and frees its channel
+ */
+static void dma_load_stop(int channel) {
+    dma_channel_abort(channel);
+    dma_channel_unclaim(channel);
+}
+
+/*
+ * serves the pending interrupts between two measurements, the interrupts are disabled again afterwards
+ */
+static void bench_serve_interrupts() {
+    restore_interrupts(saved_interrupts);
+    __isb();                                // pending interrupts are taken here
+    saved_interrupts = save_and_disable_interrupts();
+}
+
+/*
+ * serves the pending interrupts every BENCH_IRQ_WINDOW calls of a kernel, so interrupts are never disabled for
+ * more than BENCH_IRQ_WINDOW calls
+ * @param i: index of the next call
+ */
+static inline void bench_window(uint32_t i) {
+    if ((i > 0) && (i % BENCH_IRQ_WINDOW == 0)) {
+        bench_serve_interrupts();
+    }
+}
+
+static void bench_init(bench_result_t *r) {
+    r->min = UINT32_MAX;
+    r->max = 0;
+    r->sum = 0;
+    r->count = 0;
+}
+
+static void bench_add(bench_result_t *r, uint32_t cycles) {
+    r->min = cycles < r->min ? cycles : r->min;
+    r->max = cycles > r->max ? cycles : r->max;
+    r->sum += cycles;
+    r->count++;
+}
+
+/*
+ * appends the result of a kernel to the report
+ */
+static uint32_t bench_print(const char *name, bench_result_t *r, char *buf, uint32_t maxsize) {
+    if (r->count == 0) {
+        return snprintf(buf, maxsize, "%s: -\n", name);
+    }
+    return snprintf(buf, maxsize, "%s: min=%lu avg=%lu max=%lu\n", name, (unsigned long)r->min,
+                    (unsigned long)(r->sum / r->count), (unsigned long)r->max);
+}
+
+/*
+ * parks the keyer core, so the generator can be used on this core, disables the interrupts and starts SysTick.
+ * The interrupts are served between the kernels and every BENCH_IRQ_WINDOW calls (see bench_window())
+ */
+static void bench_begin() {
+    uint32_t start, end;
+
+    keyer_core_pause();
+    saved_interrupts = save_and_disable_interrupts();
+    saved_systick_csr = systick_hw->csr;
+    saved_systick_rvr = systick_hw->rvr;
+    systick_hw->rvr = SYSTICK_MASK;
+    systick_hw->cvr = 0;
+    systick_hw->csr = SYSTICK_CSR_RUN;
+
+    overhead = 0;
+    start = cycles_now();
+    end = cycles_now();
+    overhead = cycles_elapsed(start, end);
+}
+
+/*
+ * restores SysTick and the interrupts and continues the keyer core
+ */
+static void bench_end() {
+    systick_hw->csr = saved_systick_csr;
+    systick_hw->rvr = saved_systick_rvr;
+    restore_interrupts(saved_interrupts);
+    keyer_core_resume();
+}
+
+/*
+ * renders packets and steps the state machine through a stream of characters like the keyer core. The render
+ * call is resolved on the static type, a PicoCWGenerator times the inlined render path of core 1
+ * @param flush: flush the XIP cache before each packet
+ */
+template <typename GENERATOR>
+static void bench_packets(GENERATOR *cwgen, uint32_t iterations, bool flush, bench_result_t *r) {
+    char morse[] = ".-.-.";
+    uint32_t start, end;
+
+    bench_serve_interrupts();
+    for (uint32_t i = 0; i < iterations; i++) {
+        bench_window(i);
+        if (i % 1000 == 0) {
+            cwgen->reset();
+            cwgen->send_character(morse);
+        }
+        if (flush) {
+            flush_xip_cache();
+        }
+        start = cycles_now();
+        cwgen->get_audio_buffer();
+        cwgen->update_statemachine();
+        end = cycles_now();
+        bench_add(r, cycles_elapsed(start, end));
+    }
+}
+
+/*
+ * renders a pile-up with all stations keyed into a packet of silence
+ * @param stations: number of stations [1, TRAINER_MAX_STATIONS]
+ */
+static void bench_trainer(uint32_t stations, uint32_t iterations, bench_result_t *r) {
+    int16_t samples[SAMPLE_BUFFER_SIZE];
+    uint32_t start, end;
+
+    bench_serve_interrupts();
+    trainer_start(stations, 1, SAMPLE_RATE);
+    trainer_key_all();
+    for (uint32_t i = 0; i < iterations; i++) {
+        bench_window(i);
+        memset(samples, 0, sizeof(samples));
+        start = cycles_now();
+        trainer_render(samples, SAMPLE_BUFFER_SIZE);
+        end = cycles_now();
+        bench_add(r, cycles_elapsed(start, end));
+    }
+}
+
+/*
+ * runs all kernels and writes a human readable report (min/avg/max cycles per call)
+ * @param cwgen: generator of core 1 to be benchmarked
+ * @param parser: WinKeyerParser to be benchmarked
+ * @param iterations: number of calls per kernel
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t self_benchmark_run(PicoCWGenerator *cwgen, WinKeyerParser *parser, uint32_t iterations, char *buf, uint32_t maxsize) {
+    bench_result_t silence, edge, sustain, statemachine, packet, packet_cold, packet_dma, packet_dma_prio, sendchar, parse;
+    uint8_t wk_buffer[sizeof(WK_BENCH_STREAM)];
+    char morse[] = ".-.-.";
+    uint32_t start, end;
+
+    bench_init(&silence);
+    bench_init(&edge);
+    bench_init(&sustain);
+    bench_init(&statemachine);
+    bench_init(&packet);
+    bench_init(&packet_cold);
+    bench_init(&packet_dma);
+    bench_init(&packet_dma_prio);
+    bench_init(&sendchar);
+    bench_init(&parse);
+
+    bench_begin();
+
+    // render silence
+    cwgen->reset();
+    for (uint32_t i = 0; i < iterations; i++) {
+        bench_window(i);
+        start = cycles_now();
+        cwgen->get_audio_buffer();
+        end = cycles_now();
+        bench_add(&silence, cycles_elapsed(start, end));
+    }
+
+    bench_serve_interrupts();
+    // render the rising edge of a DAH (first packet of the element)
+    CWGenerator::CW_CHARACTERS dah = CWGenerator::CHAR_DAH;
+    cwgen->send_character(dah);
+    cwgen->update_statemachine();
+    for (uint32_t i = 0; i < iterations; i++) {
+        bench_window(i);
+        start = cycles_now();
+        cwgen->get_audio_buffer();
+        end = cycles_now();
+        bench_add(&edge, cycles_elapsed(start, end));
+    }
+
+    bench_serve_interrupts();
+    // render the sustained tone after the rising edge
+    for (uint32_t i = 0; i < (uint32_t)cwgen->get_risetime() + 2; i++) {             // one packet per ms
+        cwgen->update_statemachine();
+    }
+    for (uint32_t i = 0; i < iterations; i++) {
+        bench_window(i);
+        start = cycles_now();
+        cwgen->get_audio_buffer();
+        end = cycles_now();
+        bench_add(&sustain, cycles_elapsed(start, end));
+    }
+
+    bench_serve_interrupts();
+    // advance the state machine through a stream of characters
+    cwgen->reset();
+    for (uint32_t i = 0; i < iterations; i++) {
+        bench_window(i);
+        if (i % 1000 == 0) {
+            cwgen->reset();
+            cwgen->send_character(morse);
+        }
+        start = cycles_now();
+        cwgen->update_statemachine();
+        end = cycles_now();
+        bench_add(&statemachine, cycles_elapsed(start, end));
+    }
+
+    // full packet as rendered by the keyer core (render and state machine step), with a warm and a flushed XIP cache
+    // the cold case is the worst case of the callbacks if the cache was evicted, e.g. by the parser
+    bench_packets(cwgen, iterations, false, &packet);
+    bench_packets(cwgen, iterations, true, &packet_cold);
+
+    // full packet while a DMA channel writes to the striped SRAM at full speed, with the default bus priority
+    // and with the bus priority the keyer core uses
+    uint32_t priority = bus_ctrl_hw->priority;
+    int dma_channel = dma_load_start();
+    bench_packets(cwgen, iterations, false, &packet_dma);
+    bus_ctrl_hw->priority = (get_core_num() == 1) ? BUSCTRL_BUS_PRIORITY_PROC1_BITS : BUSCTRL_BUS_PRIORITY_PROC0_BITS;
+    bench_packets(cwgen, iterations, false, &packet_dma_prio);
+    bus_ctrl_hw->priority = priority;
+    dma_load_stop(dma_channel);
+
+    bench_serve_interrupts();
+    // queue a morse character
+    for (uint32_t i = 0; i < iterations; i++) {
+        bench_window(i);
+        cwgen->reset();
+        start = cycles_now();
+        cwgen->send_character(morse);
+        end = cycles_now();
+        bench_add(&sendchar, cycles_elapsed(start, end));
+    }
+
+    bench_serve_interrupts();
+    // parse the canned WinKeyer stream
+    uint16_t wpm = cwgen->get_wpm();
+    for (uint32_t i = 0; i < iterations; i++) {
+        bench_window(i);
+        cwgen->reset();
+        memcpy(wk_buffer, WK_BENCH_STREAM, sizeof(WK_BENCH_STREAM));
+        start = cycles_now();
+        parser->parse_message(wk_buffer, sizeof(wk_buffer), sizeof(wk_buffer));
+        end = cycles_now();
+        bench_add(&parse, cycles_elapsed(start, end));
+    }
+    cwgen->set_wpm(wpm);
+    cwgen->reset();
+
+    bench_end();
+
+    uint32_t len = snprintf(buf, maxsize, "bench clk_sys=%lu iterations=%lu frame_budget=%lu cycles/call\n",
+                            (unsigned long)clock_get_hz(clk_sys), (unsigned long)iterations,
+                            (unsigned long)(clock_get_hz(clk_sys) / 1000));
+    if (len < maxsize) len += bench_print("render_silence", &silence, buf + len, maxsize - len);
+    if (len < maxsize) len += bench_print("render_edge", &edge, buf + len, maxsize - len);
+    if (len < maxsize) len += bench_print("render_sustain", &sustain, buf + len, maxsize - len);
+    if (len < maxsize) len += bench_print("update_statemachine", &statemachine, buf + len, maxsize - len);
+    if (len < maxsize) len += bench_print("packet", &packet, buf + len, maxsize - len);
+    if (len < maxsize) len += bench_print("packet_cold", &packet_cold, buf + len, maxsize - len);
+    if (len < maxsize) len += bench_print("packet_dma", &packet_dma, buf + len, maxsize - len);
+    if (len < maxsize) len += bench_print("packet_dma_prio", &packet_dma_prio, buf + len, maxsize - len);
+    if (len < maxsize) len += bench_print("send_character", &sendchar, buf + len, maxsize - len);
+    if (len < maxsize) len += bench_print("parse_message", &parse, buf + len, maxsize - len);
+
+    return len < maxsize ? len : maxsize - 1;
+}
+
+/*
+ * measures the pile-up trainer and writes a human readable report of the cycles per packet and the number of
+ * stations fitting in the frame budget
+ * @param cwgen: generator of core 1 rendering the keyer packets next to the trainer
+ * @param iterations: number of calls per kernel
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t self_benchmark_trainer(PicoCWGenerator *cwgen, uint32_t iterations, char *buf, uint32_t maxsize) {
+    bench_result_t packet, one, all;
+
+    bench_init(&packet);
+    bench_init(&one);
+    bench_init(&all);
+
+    bench_begin();
+    bench_packets(cwgen, iterations, false, &packet);
+    cwgen->reset();
+    bench_trainer(1, iterations, &one);
+    bench_trainer(TRAINER_MAX_STATIONS, iterations, &all);
+    trainer_stop();
+    bench_end();
+
+    // the cost of a station is the difference of the two runs, the rest of the single station run is the noise
+    // and the mixing. The stations share the frame with the worst case packet of the keyer
+    uint32_t one_avg = one.sum / one.count;
+    uint32_t all_avg = all.sum / all.count;
+    uint32_t per_station = all_avg > one_avg ? (all_avg - one_avg) / (TRAINER_MAX_STATIONS - 1) : 1;
+    uint32_t base = one_avg > per_station ? one_avg - per_station : 0;
+    uint32_t budget = clock_get_hz(clk_sys) / 1000;
+    uint32_t used = packet.max + base;
+    uint32_t max_stations = budget > used ? (budget - used) / (per_station > 0 ? per_station : 1) : 0;
+
+    uint32_t len = snprintf(buf, maxsize, "bench clk_sys=%lu iterations=%lu frame_budget=%lu cycles/call\n",
+                            (unsigned long)clock_get_hz(clk_sys), (unsigned long)iterations, (unsigned long)budget);
+    if (len < maxsize) len += bench_print("packet", &packet, buf + len, maxsize - len);
+    if (len < maxsize) len += bench_print("trainer_1", &one, buf + len, maxsize - len);
+    if (len < maxsize) len += bench_print("trainer_max", &all, buf + len, maxsize - len);
+    if (len < maxsize) {
+        len += snprintf(buf + len, maxsize - len, "trainer per_station=%lu base=%lu max_stations=%lu\n",
+                        (unsigned long)per_station, (unsigned long)base, (unsigned long)max_stations);
+    }
+
+    return len < maxsize ? len : maxsize - 1;
+}
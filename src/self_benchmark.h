@@ -0,0 +1,68 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef _SELF_BENCHMARK_H_
+#define _SELF_BENCHMARK_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "cw_generator.h"
+#include "keyer_core.h"
+#include "winkeyer_parser.h"
+
+/*
+ * on-device benchmark of the hot kernels of the synthesis and the parser. Each kernel is executed with
+ * interrupts disabled on synthetic input and the number of clock cycles per call is measured using the
+ * SysTick timer. Pending interrupts are served between the kernels and every 100 calls. The audio stream is paused while the benchmark is running and the CWGenerator is reset
+ * to the idle state afterwards. The trainer benchmark stops a running pile-up.
+ */
+
+#define SELF_BENCHMARK_DEFAULT_ITERATIONS 100       // number of iterations if none are specified
+
+/*
+ * runs all kernels and writes a human readable report (min/avg/max cycles per call)
+ * @param cwgen: generator of core 1, the packets are rendered through the same inlined path as in the audio stream
+ * @param parser: WinKeyerParser to be benchmarked
+ * @param iterations: number of calls per kernel
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t self_benchmark_run(PicoCWGenerator *cwgen, WinKeyerParser *parser, uint32_t iterations, char *buf, uint32_t maxsize);
+
+/*
+ * measures the pile-up trainer with one and with TRAINER_MAX_STATIONS keyed stations and writes a human
+ * readable report: cycles per packet, the cost of a station and the number of stations fitting in the frame
+ * budget next to the worst case packet of the keyer
+ * @param cwgen: generator of core 1 rendering the keyer packets next to the trainer
+ * @param iterations: number of calls per kernel
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t self_benchmark_trainer(PicoCWGenerator *cwgen, uint32_t iterations, char *buf, uint32_t maxsize);
+
+#endif
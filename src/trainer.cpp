@@ -0,0 +1,381 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "trainer.h"
+
+#include <math.h>
+#include "cw_generator.h"
+
+/*
+ * virtual stations, noise and fading of the pile-up trainer
+ */
+
+#define TRAINER_SINE_SIZE (1 << TRAINER_SINE_BITS)
+#define TRAINER_SINE_SHIFT (32 - TRAINER_SINE_BITS)  // phase accumulator to sine table index
+#define TRAINER_HALF_PERIOD 0x80000000u     // envelope phase of a fully keyed station (cosine at pi)
+#define TRAINER_QUARTER_PERIOD 0x40000000u  // phase offset of the cosine
+#define TRAINER_BLOCK 64                    // samples mixed at a time
+#define TRAINER_DEFAULT_SEED 0x1D2C3B4Au    // seed used if none is given
+
+#define TRAINER_PITCH_MIN 450               // lowest pitch of a station [Hz]
+#define TRAINER_PITCH_RANGE 400             // pitches are spread over [min, min + range)
+#define TRAINER_WPM_MIN 18                  // slowest station [WPM]
+#define TRAINER_WPM_RANGE 18
+#define TRAINER_LEVEL_MIN 20                // weakest station [%]
+#define TRAINER_LEVEL_RANGE 81
+#define TRAINER_QSB_DEPTH_MAX 80            // deepest fading [%]
+#define TRAINER_QSB_PERIOD_MIN 2            // fastest fading period [s]
+#define TRAINER_QSB_PERIOD_RANGE 9
+#define TRAINER_PAUSE_MIN_MS 500            // shortest pause of a station between two calls
+#define TRAINER_PAUSE_RANGE_MS 2500
+
+// state of a virtual station, rendered sample by sample
+typedef struct {
+    char call[TRAINER_CALL_MAX + 1];        // callsign
+    char code[TRAINER_CODE_MAX + 1];        // morse code of the callsign, characters separated by ' '
+    uint16_t pitch;                         // tone frequency [Hz]
+    uint16_t wpm;                           // speed [WPM]
+    uint16_t level;                         // level [%]
+    uint16_t qsb_depth;                     // fading depth [%]
+    uint16_t qsb_period;                    // fading period [s]
+    uint32_t phase;                         // tone oscillator, a period is 2^32
+    uint32_t phase_inc;
+    uint32_t ramp;                          // keying envelope phase [0, TRAINER_HALF_PERIOD]
+    uint32_t ramp_inc;
+    uint32_t qsb_phase;                     // fading oscillator, a period is 2^32
+    uint32_t qsb_inc;
+    int32_t amplitude;                      // amplitude without fading
+    int32_t depth_q15;                      // fading depth (Q15)
+    uint32_t dit;                           // samples of a dit
+    uint32_t pause;                         // samples of the pause between two calls (mean)
+    uint32_t remaining;                     // samples left of the current element or gap
+    uint32_t pos;                           // next position in code
+    bool key_down;                          // the current element is keyed
+} trainer_station_t;
+
+static int16_t sine_table[TRAINER_SINE_SIZE];       // Q15 sine, in RAM for the audio path
+static bool sine_ready = false;
+static trainer_station_t stations[TRAINER_MAX_STATIONS];
+static uint32_t station_count = 0;
+static volatile bool running = false;
+static volatile int32_t noise_gain = 0;             // Q15 gain of the white noise
+static uint32_t noise_level = TRAINER_DEFAULT_NOISE;  // noise level [%], kept across pile-ups
+static uint32_t noise_state = TRAINER_DEFAULT_SEED; // xorshift32 state of the noise (core 1)
+static int32_t noise_lowpass = 0;                   // state of the noise lowpass
+static uint32_t random_state = TRAINER_DEFAULT_SEED;  // xorshift32 state of the station timing and parameters
+
+extern const char *WK123_CW_MAPPING[];              // defined in winkeyer_parser.cpp
+
+/*
+ * advances a xorshift32 generator
+ * @param state: state of the generator, never 0
+ * @return next pseudo random number
+ */
+static inline uint32_t xorshift32(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/*
+ * returns a pseudo random number of the station generator
+ * @param range: size of the range
+ * @return number in [0, range)
+ */
+static inline uint32_t random_below(uint32_t range) {
+    return xorshift32(&random_state) % range;
+}
+
+/*
+ * returns the sine of a phase
+ * @param phase: phase, a period is 2^32
+ * @return sine (Q15)
+ */
+static inline int32_t sine(uint32_t phase) {
+    return sine_table[phase >> TRAINER_SINE_SHIFT];
+}
+
+/*
+ * creates a random callsign: one or two prefix letters, a digit and a suffix of one to three letters
+ * @param call: buffer of TRAINER_CALL_MAX + 1 characters
+ */
+static void random_call(char *call) {
+    uint32_t len = 0;
+
+    uint32_t prefix = 1 + random_below(2);
+    for (uint32_t i = 0; i < prefix; i++) {
+        call[len++] = 'A' + random_below(26);
+    }
+    call[len++] = '0' + random_below(10);
+    uint32_t suffix = 1 + random_below(3);
+    for (uint32_t i = 0; i < suffix; i++) {
+        call[len++] = 'A' + random_below(26);
+    }
+    call[len] = '\0';
+}
+
+/*
+ * translates a callsign to morse code, the characters are separated by ' '
+ * @param call: callsign of upper case letters and digits
+ * @param code: buffer of TRAINER_CODE_MAX + 1 characters
+ */
+static void encode_call(const char *call, char *code) {
+    uint32_t len = 0;
+
+    for (const char *c = call; *c != '\0'; c++) {
+        const char *morse = WK123_CW_MAPPING[*c - 0x20];
+        if ((len > 0) && (len < TRAINER_CODE_MAX)) {
+            code[len++] = ' ';
+        }
+        while ((*morse != '\0') && (len < TRAINER_CODE_MAX)) {
+            code[len++] = *morse++;
+        }
+    }
+    code[len] = '\0';
+}
+
+/*
+ * initializes a station with random parameters, it starts after a random pause
+ */
+static void init_station(trainer_station_t *st, uint32_t sample_rate) {
+    random_call(st->call);
+    encode_call(st->call, st->code);
+    st->pitch = TRAINER_PITCH_MIN + random_below(TRAINER_PITCH_RANGE);
+    st->wpm = TRAINER_WPM_MIN + random_below(TRAINER_WPM_RANGE);
+    st->level = TRAINER_LEVEL_MIN + random_below(TRAINER_LEVEL_RANGE);
+    st->qsb_depth = random_below(TRAINER_QSB_DEPTH_MAX + 1);
+    st->qsb_period = TRAINER_QSB_PERIOD_MIN + random_below(TRAINER_QSB_PERIOD_RANGE);
+
+    st->phase = xorshift32(&random_state);
+    st->phase_inc = (uint32_t)(((uint64_t)st->pitch << 32) / sample_rate);
+    st->ramp = 0;
+    st->ramp_inc = TRAINER_HALF_PERIOD / (sample_rate * TRAINER_RAMP_MS / 1000);
+    st->qsb_phase = xorshift32(&random_state);
+    st->qsb_inc = (uint32_t)((1ull << 32) / ((uint64_t)sample_rate * st->qsb_period));
+    st->amplitude = st->level * TRAINER_STATION_AMPLITUDE / 100;
+    st->depth_q15 = st->qsb_depth * 32767 / 100;
+    st->dit = sample_rate * 6 / (5 * st->wpm);   // PARIS: 50 dits per word
+    st->pause = sample_rate * TRAINER_PAUSE_MIN_MS / 1000;
+    st->remaining = st->pause + random_below(sample_rate * TRAINER_PAUSE_RANGE_MS / 1000);
+    st->pos = 0;
+    st->key_down = false;
+}
+
+/*
+ * moves a station to its next element, gap or pause between two calls
+ */
+static void __not_in_flash_func(next_element)(trainer_station_t *st) {
+    if (st->key_down) {
+        st->key_down = false;
+        st->remaining = st->dit * INTRA_CHAR_PAUSE_UNITS;
+        return;
+    }
+
+    char c = st->code[st->pos];
+    if (c == '\0') {
+        st->pos = 0;
+        st->remaining = st->pause + random_below(st->pause * (TRAINER_PAUSE_RANGE_MS / TRAINER_PAUSE_MIN_MS));
+        return;
+    }
+    st->pos++;
+    if (c == ' ') {
+        st->remaining = st->dit * (INTER_CHAR_PAUSE_UNITS - INTRA_CHAR_PAUSE_UNITS);
+        return;
+    }
+    st->key_down = true;
+    st->remaining = st->dit * (c == '-' ? DAH_UNITS : DIT_UNITS);
+}
+
+/*
+ * adds a station to the mix
+ * @param mix: samples of the block
+ * @param count: samples of the block [1, TRAINER_BLOCK]
+ */
+static void __not_in_flash_func(render_station)(trainer_station_t *st, int32_t *mix, uint32_t count) {
+    // fading is constant within a block: gain = amplitude * (1 - depth * (1 + sin) / 2)
+    st->qsb_phase += st->qsb_inc * count;
+    int32_t fade = 32767 - ((st->depth_q15 * ((32767 + sine(st->qsb_phase)) >> 1)) >> 15);
+    int32_t gain = (st->amplitude * fade) >> 15;
+
+    // silent for the whole block
+    if (!st->key_down && (st->ramp == 0) && (st->remaining > count)) {
+        st->remaining -= count;
+        st->phase += st->phase_inc * count;
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (st->remaining == 0) {
+            next_element(st);
+        }
+        st->remaining--;
+
+        if (st->key_down) {
+            st->ramp = st->ramp + st->ramp_inc < TRAINER_HALF_PERIOD ? st->ramp + st->ramp_inc : TRAINER_HALF_PERIOD;
+        } else {
+            st->ramp = st->ramp > st->ramp_inc ? st->ramp - st->ramp_inc : 0;
+        }
+        if (st->ramp != 0) {
+            // raised cosine envelope (1 - cos) / 2 (Q15)
+            int32_t envelope = (32767 - sine(st->ramp + TRAINER_QUARTER_PERIOD)) >> 1;
+            int32_t sample = (sine(st->phase) * envelope) >> 15;
+            mix[i] += (sample * gain) >> 15;
+        }
+        st->phase += st->phase_inc;
+    }
+}
+
+/*
+ * writes band noise into the mix: white noise of the PRNG through a one-pole lowpass (about 2 kHz at 48 kHz)
+ * @param mix: samples of the block
+ * @param count: samples of the block [1, TRAINER_BLOCK]
+ */
+static void __not_in_flash_func(render_noise)(int32_t *mix, uint32_t count) {
+    int32_t gain = noise_gain;
+    int32_t y = noise_lowpass;
+
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t white = ((int32_t)xorshift32(&noise_state) >> 16) * gain >> 15;
+        y += (white - y) >> 2;
+        mix[i] = y;
+    }
+    noise_lowpass = y;
+}
+
+/*
+ * starts a new pile-up with random stations
+ * @param count: number of stations [1, TRAINER_MAX_STATIONS]
+ * @param seed: seed of the station parameters and the noise, 0 is replaced by a fixed seed
+ * @param sample_rate: sample rate of the stream [Hz]
+ */
+void trainer_start(uint32_t count, uint32_t seed, uint32_t sample_rate) {
+    running = false;
+
+    if (!sine_ready) {
+        for (uint32_t i = 0; i < TRAINER_SINE_SIZE; i++) {
+            sine_table[i] = (int16_t)lrintf(32767.0f * sinf(2.0f * (float)M_PI * i / TRAINER_SINE_SIZE));
+        }
+        sine_ready = true;
+    }
+
+    random_state = seed != 0 ? seed : TRAINER_DEFAULT_SEED;
+    noise_state = xorshift32(&random_state);
+    noise_lowpass = 0;
+    station_count = count < 1 ? 1 : (count > TRAINER_MAX_STATIONS ? TRAINER_MAX_STATIONS : count);
+    for (uint32_t i = 0; i < station_count; i++) {
+        init_station(&stations[i], sample_rate);
+    }
+    trainer_set_noise(noise_level);
+
+    running = true;
+}
+
+/*
+ * stops the pile-up
+ */
+void trainer_stop() {
+    running = false;
+}
+
+/*
+ * sets the level of the band noise
+ * @param level: noise level [%], limited to [0, 100]
+ */
+void trainer_set_noise(uint32_t level) {
+    noise_level = level > 100 ? 100 : level;
+    noise_gain = noise_level * TRAINER_NOISE_AMPLITUDE / 100;
+}
+
+/*
+ * keys all stations continuously at full level until the next trainer_start()
+ */
+void trainer_key_all() {
+    for (uint32_t i = 0; i < station_count; i++) {
+        stations[i].key_down = true;
+        stations[i].ramp = TRAINER_HALF_PERIOD;
+        stations[i].remaining = UINT32_MAX;
+        stations[i].depth_q15 = 0;
+    }
+}
+
+/*
+ * returns if a pile-up is running
+ * @return true between trainer_start() and trainer_stop()
+ */
+bool trainer_is_running() {
+    return running;
+}
+
+/*
+ * adds the stations and the noise to a packet, saturating at the limits of the samples
+ * @param out: packet the pile-up is added to
+ * @param count: number of samples of the packet
+ */
+void __not_in_flash_func(trainer_render)(int16_t *out, uint32_t count) {
+    int32_t mix[TRAINER_BLOCK];
+
+    if (!running) {
+        return;
+    }
+
+    while (count > 0) {
+        uint32_t n = count < TRAINER_BLOCK ? count : TRAINER_BLOCK;
+
+        render_noise(mix, n);
+        for (uint32_t s = 0; s < station_count; s++) {
+            render_station(&stations[s], mix, n);
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            int32_t sum = out[i] + mix[i];
+            out[i] = sum > INT16_MAX ? INT16_MAX : (sum < INT16_MIN ? INT16_MIN : sum);
+        }
+
+        out += n;
+        count -= n;
+    }
+}
+
+/*
+ * writes a human readable report of the noise level and the stations
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t trainer_report(char *buf, uint32_t maxsize) {
+    uint32_t len = snprintf(buf, maxsize, "trainer running=%d stations=%lu noise=%lu%%\n", running ? 1 : 0,
+                            (unsigned long)(running ? station_count : 0), (unsigned long)noise_level);
+
+    for (uint32_t i = 0; running && (i < station_count) && (len < maxsize); i++) {
+        trainer_station_t *st = &stations[i];
+        len += snprintf(buf + len, maxsize - len, "%s pitch=%u wpm=%u level=%u%% qsb=%u%%/%us\n", st->call,
+                        (unsigned)st->pitch, (unsigned)st->wpm, (unsigned)st->level, (unsigned)st->qsb_depth,
+                        (unsigned)st->qsb_period);
+    }
+
+    return len < maxsize ? len : maxsize - 1;
+}
@@ -0,0 +1,102 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022 Jochen Schaeuble
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef _TRAINER_H_
+#define _TRAINER_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "pico/stdlib.h"
+
+/*
+ * pile-up trainer: renders several virtual stations calling random callsigns into the microphone stream, so the
+ * device is a standalone practice source without software on the PC. Each station has its own pitch, speed and
+ * level and fades with a slow QSB oscillator, band noise from an integer PRNG is added below. Everything is
+ * rendered in fixed point (Q15 samples and gains, 32 bit phase accumulators) on core 1 after the keyer tone, so
+ * the own keying is heard on top of the pile-up. Stations and noise are changed only while core 1 is parked.
+ * The rendering time grows linearly with the number of keyed stations, the trainer benchmark (admin command 0x27)
+ * reports the cost of a station per packet and the number of stations that fits in the frame budget.
+ */
+
+#define TRAINER_MAX_STATIONS 16             // maximum number of virtual stations
+#define TRAINER_DEFAULT_STATIONS 3          // stations started without a count
+#define TRAINER_DEFAULT_NOISE 20            // band noise level [%] until it is changed
+#define TRAINER_SINE_BITS 10                // the sine table has 2^TRAINER_SINE_BITS entries
+#define TRAINER_RAMP_MS 5                   // rise and fall time of the raised cosine keying envelope
+#define TRAINER_STATION_AMPLITUDE 6000      // amplitude of a station at 100% level and without fading
+#define TRAINER_NOISE_AMPLITUDE 12000       // amplitude of the white noise at 100% before the lowpass
+#define TRAINER_CALL_MAX 7                  // maximum length of a random callsign
+#define TRAINER_CODE_MAX 48                 // maximum length of the morse code of a callsign
+
+/*
+ * starts a new pile-up with random stations, replaces the running one (core 1 parked or not running)
+ * @param count: number of stations [1, TRAINER_MAX_STATIONS]
+ * @param seed: seed of the station parameters and the noise, 0 is replaced by a fixed seed
+ * @param sample_rate: sample rate of the stream [Hz]
+ */
+void trainer_start(uint32_t count, uint32_t seed, uint32_t sample_rate);
+
+/*
+ * stops the pile-up, the stream carries only the keyer tone again
+ */
+void trainer_stop();
+
+/*
+ * sets the level of the band noise (core 1 parked or not running)
+ * @param level: noise level [%], limited to [0, 100]
+ */
+void trainer_set_noise(uint32_t level);
+
+/*
+ * keys all stations continuously at full level until the next trainer_start(), the worst case of the
+ * rendering measured by the self-benchmark
+ */
+void trainer_key_all();
+
+/*
+ * returns if a pile-up is running
+ * @return true between trainer_start() and trainer_stop()
+ */
+bool trainer_is_running();
+
+/*
+ * adds the stations and the noise to a packet, saturating at the limits of the samples. Does nothing if the
+ * trainer is not running (core 1, audio path)
+ * @param out: packet the pile-up is added to
+ * @param count: number of samples of the packet
+ */
+void trainer_render(int16_t *out, uint32_t count);
+
+/*
+ * writes a human readable report of the noise level and the callsign, pitch, speed, level and fading of each
+ * station
+ * @param buf: buffer the report is written to
+ * @param maxsize: size of the buffer
+ * @return number of bytes written to the buffer
+ */
+uint32_t trainer_report(char *buf, uint32_t maxsize);
+
+#endif
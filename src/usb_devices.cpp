@@ -46,6 +46,9 @@ audio_control_range_4_n_t(1) sampleFreqRng;
 static usb_microphone_tx_pre_handler_t usb_microphone_tx_pre_handler = NULL;
 static usb_microphone_tx_post_handler_t usb_microphone_tx_post_handler = NULL;
 static usb_microphone_volume_handler_t usb_microphone_volume_handler = NULL;
+static usb_microphone_stream_handler_t usb_microphone_stream_handler = NULL;
+static usb_devices_suspend_handler_t usb_devices_suspend_handler = NULL;
+static usb_devices_mount_handler_t usb_devices_mount_handler = NULL;
 
 /*------------- MAIN -------------*/
 void usb_devices_init() {
@@ -80,7 +83,19 @@ void usb_microphone_set_volume_handler(usb_microphone_volume_handler_t handler)
     usb_microphone_volume_handler = handler;
 }
 
-uint16_t usb_microphone_write(const void *data, uint16_t len) {
+void usb_microphone_set_stream_handler(usb_microphone_stream_handler_t handler) {
+    usb_microphone_stream_handler = handler;
+}
+
+void usb_devices_set_suspend_handler(usb_devices_suspend_handler_t handler) {
+    usb_devices_suspend_handler = handler;
+}
+
+void usb_devices_set_mount_handler(usb_devices_mount_handler_t handler) {
+    usb_devices_mount_handler = handler;
+}
+
+uint16_t __not_in_flash_func(usb_microphone_write)(const void *data, uint16_t len) {
     return tud_audio_write((uint8_t *)data, len);
 //    return tud_audio_write_support_ff(0, (uint8_t *)data, len);
 }
@@ -89,6 +104,10 @@ void usb_devices_task() {
     tud_task();
 }
 
+bool usb_devices_task_ready() {
+    return tud_task_event_ready();
+}
+
 //--------------------------------------------------------------------+
 // Application Callback API Implementations
 //--------------------------------------------------------------------+
@@ -322,7 +341,7 @@ bool tud_audio_get_req_entity_cb(uint8_t rhport, tusb_control_request_t const *p
     return false;  // Yet not implemented
 }
 
-bool tud_audio_tx_done_pre_load_cb(uint8_t rhport, uint8_t itf, uint8_t ep_in, uint8_t cur_alt_setting) {
+bool __not_in_flash_func(tud_audio_tx_done_pre_load_cb)(uint8_t rhport, uint8_t itf, uint8_t ep_in, uint8_t cur_alt_setting) {
     (void)rhport;
     (void)itf;
     (void)ep_in;
@@ -335,7 +354,7 @@ bool tud_audio_tx_done_pre_load_cb(uint8_t rhport, uint8_t itf, uint8_t ep_in, u
     return true;
 }
 
-bool tud_audio_tx_done_post_load_cb(uint8_t rhport, uint16_t n_bytes_copied, uint8_t itf, uint8_t ep_in, uint8_t cur_alt_setting) {
+bool __not_in_flash_func(tud_audio_tx_done_post_load_cb)(uint8_t rhport, uint16_t n_bytes_copied, uint8_t itf, uint8_t ep_in, uint8_t cur_alt_setting) {
     (void)rhport;
     (void)n_bytes_copied;
     (void)itf;
@@ -349,10 +368,53 @@ bool tud_audio_tx_done_post_load_cb(uint8_t rhport, uint16_t n_bytes_copied, uin
     return true;
 }
 
+// Invoked when the host selects an alternate setting of the streaming interface, alternate setting 1 starts the stream
+bool tud_audio_set_itf_cb(uint8_t rhport, tusb_control_request_t const *p_request) {
+    (void)rhport;
+
+    if (usb_microphone_stream_handler) {
+        usb_microphone_stream_handler(TU_U16_LOW(p_request->wValue) != 0);
+    }
+    return true;
+}
+
+// Invoked when the host selects the zero bandwidth alternate setting 0, the stream is stopped
 bool tud_audio_set_itf_close_EP_cb(uint8_t rhport, tusb_control_request_t const *p_request) {
     (void)rhport;
     (void)p_request;
 
-    printf("tud_audio_set_itf_close_EP_cb\n");
+    if (usb_microphone_stream_handler) {
+        usb_microphone_stream_handler(false);
+    }
     return true;
 }
+
+// Invoked when the host has set the configuration, the enumeration is finished
+void tud_mount_cb(void) {
+    if (usb_devices_mount_handler) {
+        usb_devices_mount_handler();
+    }
+}
+
+// Invoked when the device is unmounted (bus reset or cable removed), the stream is closed implicitly
+void tud_umount_cb(void) {
+    if (usb_microphone_stream_handler) {
+        usb_microphone_stream_handler(false);
+    }
+}
+
+// Invoked when the bus is suspended (no SOF for 3 ms), the device has to reduce its current draw
+void tud_suspend_cb(bool remote_wakeup_en) {
+    (void)remote_wakeup_en;
+
+    if (usb_devices_suspend_handler) {
+        usb_devices_suspend_handler(true);
+    }
+}
+
+// Invoked when the bus is resumed
+void tud_resume_cb(void) {
+    if (usb_devices_suspend_handler) {
+        usb_devices_suspend_handler(false);
+    }
+}
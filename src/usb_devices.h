@@ -46,12 +46,19 @@
 typedef void (*usb_microphone_tx_pre_handler_t)(void);
 typedef void (*usb_microphone_tx_post_handler_t)(void);
 typedef void (*usb_microphone_volume_handler_t)(uint8_t channel, uint16_t volume, bool mute);
+typedef void (*usb_microphone_stream_handler_t)(bool open);
+typedef void (*usb_devices_suspend_handler_t)(bool suspended);
+typedef void (*usb_devices_mount_handler_t)(void);
 
 void usb_devices_init();
 void usb_microphone_set_tx_pre_handler(usb_microphone_tx_pre_handler_t handler);
 void usb_microphone_set_tx_post_handler(usb_microphone_tx_post_handler_t handler);
 void usb_microphone_set_volume_handler(usb_microphone_volume_handler_t handler);
+void usb_microphone_set_stream_handler(usb_microphone_stream_handler_t handler);
+void usb_devices_set_suspend_handler(usb_devices_suspend_handler_t handler);
+void usb_devices_set_mount_handler(usb_devices_mount_handler_t handler);
 void usb_devices_task();
+bool usb_devices_task_ready();
 uint16_t usb_microphone_write(const void * data, uint16_t len);
 
 #endif
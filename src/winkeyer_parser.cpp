@@ -25,10 +25,19 @@
 
 #include "winkeyer_parser.h"
 #include "pico/bootrom.h"
+#include "boot_stats.h"
+#include "latency_stats.h"
+#include "led_health.h"
+#include "mem_stats.h"
+#include "paddle_capture.h"
+#include "pc_profiler.h"
+#include "power_manager.h"
+#include "scheduler.h"
 
 /* 
  * class that parses the WinKeyer commands passed through a serial interface
- * Simplified parser without buffered command support. Information after command is ignored.
+ * Simplified parser without buffered command support. Commands split across serial reads are completed with the
+ * next read, all commands of a read are executed and their replies are returned together.
  */
 
 /*
@@ -119,8 +128,7 @@ const uint16_t WK12_FREQUENCY_LIST[] = {
 };
 
 /*
- * Contains the size of each admin command including the leading 0x00
- * TODO: Parse also parital admin commands
+ * Contains the size of each admin command including the leading 0x00, unknown admin commands have a size of 2
  */
 const uint8_t WK123_ADMIN_COMMAND_SIZE[] = {
     3,              // 0: Calibrate - ignored
@@ -148,66 +156,156 @@ const uint8_t WK123_ADMIN_COMMAND_SIZE[] = {
     3,              // 22: Load X2MODE - ignored
     2,              // 23: Get FW Minor Rev
     2,              // 24: Get IC Type
-    3               // 25: Get Sidetone Volume
+    3,              // 25: Get Sidetone Volume
+    3,              // 26: Set rise time
+    3,              // 27: Set frequency
+    2,              // 28: Enter bootloader
+    3,              // 29: Latency histogram
+    4,              // 30: PC profiler
+    2,              // 31: Memory report
+    3,              // 32: Self-benchmark
+    4,              // 33: Paddle edge capture
+    3,              // 34: LED mode
+    3,              // 35: Render-ahead depth
+    3,              // 36: Scheduler report
+    3,              // 37: Power report
+    2,              // 38: Boot report
+    4               // 39: Pile-up trainer
 };
 
+/*
+ * returns the size of a command including its parameters
+ * @param command: first bytes of the command
+ * @param length: number of bytes received so far [1, WK_COMMAND_MAX]
+ * @return size of the command, 0 if more bytes are needed to tell the size
+ */
+static uint32_t command_size(const uint8_t *command, uint32_t length) {
+    switch (command[0]) {
+        case 0x00:                // Admin command, the size depends on the admin command
+            if (length < 2) {
+                return 0;
+            }
+            return command[1] < sizeof(WK123_ADMIN_COMMAND_SIZE) ? WK123_ADMIN_COMMAND_SIZE[command[1]] : 2;
+        case 0x01:                // Sidetone Freq
+        case 0x09:                // Pin Configuration
+            return 2;
+        case 0x02:                // Speed, a speed out of range is not taken as parameter
+            if (length < 2) {
+                return 0;
+            }
+            return (command[1] >= 5) && (command[1] <= 99) ? 2 : 1;
+        default:                  // CW text and commands without parameters
+            return 1;
+    }
+}
+
+/*
+ * returns if a command writes a reply
+ * @param command: first byte of the command
+ * @return true for admin commands, Get Speed Pot and Status
+ */
+static bool command_replies(uint8_t command) {
+    return (command == 0x00) || (command == 0x07) || (command == 0x15);
+}
+
 /* 
  * constructor for the morse code sound generator with default frequency and speed
  * @param cwgen: CWGenerator used to send text messages
  */
 WinKeyerParser::WinKeyerParser(CWGenerator *cwgen) {
     cw_generator = cwgen;
+    cw_generators[0] = cwgen;
 }
 
 /*
- * parses admin commands
- * @param message message to parse. message[0] corresponds to <0> which indicates an admin command
- * @param offset start position of admin message
- * @param length length of the provided message
- * @param maxsize buffer size
- * @return number of bytes added to the result;
+ * sets the handler of the render-ahead admin command
+ * @param handler: called with the requested number of packets rendered ahead of the USB stream (0: query)
  */
-uint32_t WinKeyerParser::parse_admin_command(uint8_t *message, int *offset, uint32_t length, uint32_t maxsize) {
-    int offs = *offset;
-    (*offset)++;              // skip parameter in message
+void WinKeyerParser::set_render_ahead_handler(render_ahead_handler_t handler) {
+    render_ahead_handler = handler;
+}
 
-    // only accept full commands
-    if (length - offs < 2) {
-        return 0;
+/*
+ * sets the handler of the self-benchmark admin command
+ * @param handler: called with the number of iterations per kernel (0: default), returns the number of bytes written to buf
+ */
+void WinKeyerParser::set_benchmark_handler(benchmark_handler_t handler) {
+    benchmark_handler = handler;
+}
+
+/*
+ * sets the handler of the trainer admin command
+ * @param handler: called with the operation and its argument, returns the number of bytes written to buf
+ */
+void WinKeyerParser::set_trainer_handler(trainer_handler_t handler) {
+    trainer_handler = handler;
+}
+
+/*
+ * sets the generator of a keying output
+ * @param index: keying output [0, WK_MAX_GENERATORS - 1]
+ * @param cwgen: generator keying the radio on this output
+ */
+void WinKeyerParser::set_generator(uint32_t index, CWGenerator *cwgen) {
+    if (index >= WK_MAX_GENERATORS) {
+        return;
+    }
+    if (cw_generators[index] == cw_generator) {
+        cw_generator = cwgen;
     }
+    cw_generators[index] = cwgen;
+}
 
-    switch(message[offs + 1]) {
+/*
+ * selects the generator receiving the text and parameter commands and connects the paddles to it
+ * @param index: keying output [0, WK_MAX_GENERATORS - 1], outputs without generator are ignored
+ */
+void WinKeyerParser::select_generator(uint32_t index) {
+    if ((index >= WK_MAX_GENERATORS) || (cw_generators[index] == NULL) || (cw_generators[index] == cw_generator)) {
+        return;
+    }
+
+    cw_generator->set_paddles(false);
+    cw_generator = cw_generators[index];
+    cw_generator->set_paddles(true);
+}
+
+/*
+ * parses admin commands
+ * @param command complete admin command. command[0] corresponds to <0> which indicates an admin command
+ * @param reply buffer the reply is written to
+ * @param maxsize size of the reply buffer
+ * @return number of bytes added to the result;
+ */
+uint32_t WinKeyerParser::parse_admin_command(const uint8_t *command, uint8_t *reply, uint32_t maxsize) {
+    switch(command[1]) {
         case 0:                 // 0x00: Calibrate - ignored
             break;
         case 1:                 // 0x01: Reset - ignored
             break;
         case 2:                 // 0x02: Host Open
-            message[0] = 31;    // echo back revision 31 for rev 31.03 (version according to datasheet)
-            message[1] = 03;
+            reply[0] = 31;      // echo back revision 31 for rev 31.03 (version according to datasheet)
+            reply[1] = 03;
             wk_version = 1;     // according to datasheet WK1 mode is set on host open
             return 2;
         case 3:                 // 0x03: Host Close - ignored
             break;
         case 4:                 // 0x04: Echo Test
-            if (length - offs >= 3) {
-                message[0] = message[offs + 2];
-                (*offset)++;    // skip parameter in message
-                return 1;
-            }
-            break;
+            reply[0] = command[2];
+            return 1;
         case 5:                 // 0x05: Paddle A2D - always return 0, according to datasheet
-            message[0] = 0;
+            reply[0] = 0;
             return 1;
         case 6:                 // 0x06: Speed A2D - always return 0, according to datasheet
-            message[0] = 0;
+            reply[0] = 0;
             return 1;
         case 7:                 // 0x07: Get Values - always return 0, according to datasheet
-            message[0] = 0;
+            reply[0] = 0;
             return 1;
         case 8:                 // 0x08: Reserved - ignored
             break;
         case 9:                 // 0x09: Get FW Major Rev
-            message[0] = 31;    // echo back revision 31 for rev 31.03 (version according to datasheet)
+            reply[0] = 31;      // echo back revision 31 for rev 31.03 (version according to datasheet)
             return 1;
         case 10:                // 0x0A: Set WK1 Mode
             wk_version = 1;
@@ -235,37 +333,110 @@ uint32_t WinKeyerParser::parse_admin_command(uint8_t *message, int *offset, uint
             wk_version = 3;
             break;
         case 21:                // 0x15: Read Back Vcc
-            message[0] = 52;    // always report back ~5V (according to datasheet: 26214/byte value = Voltage * 100)
+            reply[0] = 52;      // always report back ~5V (according to datasheet: 26214/byte value = Voltage * 100)
             return 1;
         case 22:                // 0x16: Load X2MODE - ignored
             break;
         case 23:                // 0x17: Get FW Minor Rev
-            message[0] = 03;    // echo back revision 31 for rev 31.03 (version according to datasheet)
+            reply[0] = 03;      // echo back revision 31 for rev 31.03 (version according to datasheet)
             return 1;
         case 24:                // 0x18: Get IC Type
-            message[0] = 0x01;  // always report SMT IC
+            reply[0] = 0x01;    // always report SMT IC
             return 1;
         case 25:                // 0x19: Set Sidetone Volume - ignored as changes lead to disturbed audio on Windows
-            /*(*offset)++;              // skip parameter in message
-            if ((length - offs >= 3) && (message[offs + 2] >= 0) && (message[offs + 2] <= 4)) {
-                cw_generator->set_volume(message[offs + 2] * 100 / 4);
+            /*if ((command[2] >= 0) && (command[2] <= 4)) {
+                cw_generator->set_volume(command[2] * 100 / 4);
             }*/
             break;
         case 26:                // 0x1A: Set rise time of Blackman window
-            (*offset)++;              // skip parameter in message
-            if ((length - offs >= 3) && (message[offs + 2] >= 1) && (message[offs + 2] <= 50)) {
-                cw_generator->set_risetime((float)((uint8_t)message[offs + 2]));
+            if ((command[2] >= 1) && (command[2] <= 50)) {
+                cw_generator->set_risetime((float)((uint8_t)command[2]));
             }
             break;
 /*        case 27:                // 0x1B: Get rise time of Blackman window
-            message[0] = (uint8_t)cw_generator->get_risetime();
+            reply[0] = (uint8_t)cw_generator->get_risetime();
             return 1;*/
         case 27:                // 0x1B: Set 
-            (*offset)++;
-            cw_generator->set_frequency((uint8_t)message[offs + 2] * 10);
+            cw_generator->set_frequency((uint8_t)command[2] * 10);
             break;
         case 28:                // 0x1C: enter bootloader with default values
             reset_usb_boot(0, 0);
+            break;
+        case 29:                // 0x1D: Paddle-to-audio latency histogram (parameter 0: report, 1: reset)
+            if (command[2] == 1) {
+                latency_stats_reset();
+            } else {
+                return latency_stats_report((char *)reply, maxsize);
+            }
+            break;
+        case 30:                // 0x1E: PC profiler (parameters <op> <arg>)
+            switch (command[2]) {
+                case 0:             // stop sampling
+                    pc_profiler_stop();
+                    break;
+                case 1:             // start sampling with <arg> * 100 Hz (0: default rate)
+                    pc_profiler_start(command[3] > 0 ? command[3] * 100 : PC_PROFILER_DEFAULT_RATE);
+                    break;
+                case 2:             // dump page <arg> of the histogram
+                    return pc_profiler_dump(command[3], (char *)reply, maxsize);
+                case 3:             // clear the histogram
+                    pc_profiler_clear();
+                    break;
+                default:
+                    break;
+            }
+            break;
+        case 31:                // 0x1F: Memory report (stack high-water marks, heap, allocation table)
+            return mem_stats_report((char *)reply, maxsize);
+        case 32:                // 0x20: Self-benchmark of synthesis and parser (parameter: iterations / 10, 0: default)
+            if (benchmark_handler != NULL) {
+                return benchmark_handler(command[2] * 10, (char *)reply, maxsize);
+            }
+            break;
+        case 33:                // 0x21: Raw paddle edge capture (parameters <op> <arg>)
+            switch (command[2]) {
+                case 0:             // stop the capture
+                    paddle_capture_stop();
+                    break;
+                case 1:             // clear the buffer and start a new capture
+                    paddle_capture_start(cw_generator->get_wpm());
+                    break;
+                case 2:             // dump page <arg> of the capture
+                    return paddle_capture_dump(command[3], (char *)reply, maxsize);
+                default:
+                    break;
+            }
+            break;
+        case 34:                // 0x22: LED mode (parameter 0: keyer state, 1: health: load, text buffer, underruns)
+            led_health_enable(command[2] == 1);
+            break;
+        case 35:                // 0x23: Render-ahead depth (parameter: packets, 0: query), returns the depth in use
+            if (render_ahead_handler != NULL) {
+                reply[0] = render_ahead_handler(command[2]);
+                return 1;
+            }
+            break;
+        case 36:                // 0x24: Scheduler task report (parameter 0: report, 1: reset)
+            if (command[2] == 1) {
+                scheduler_reset_stats();
+            } else {
+                return scheduler_report((char *)reply, maxsize);
+            }
+            break;
+        case 37:                // 0x25: Power report (parameter 0: report, 1: reset)
+            if (command[2] == 1) {
+                power_manager_reset();
+            } else {
+                return power_manager_report((char *)reply, maxsize);
+            }
+            break;
+        case 38:                // 0x26: Boot report (time of the startup milestones)
+            return boot_stats_report((char *)reply, maxsize);
+        case 39:                // 0x27: Pile-up trainer (parameters <op> <arg>)
+            if (trainer_handler != NULL) {
+                return trainer_handler(command[2], command[3], (char *)reply, maxsize);
+            }
+            break;
         default:                // Unknown admin command - ignore
             break;
     }
@@ -274,112 +445,164 @@ uint32_t WinKeyerParser::parse_admin_command(uint8_t *message, int *offset, uint
 }
 
 /*
- * parses the provided message and acts accordingly
+ * executes a complete command
+ * @param command: command including its parameters, command[0] is the CW text or command byte
+ * @param reply: buffer the reply is written to
+ * @param maxsize: size of the reply buffer
+ * @return number of bytes written to the reply buffer
+ */
+uint32_t WinKeyerParser::parse_command(const uint8_t *command, uint8_t *reply, uint32_t maxsize) {
+    uint8_t cmd = command[0];
+
+    if ((cmd >= 0x61) && (cmd <= 0x7a)) {
+        // convert small letters to upper case
+        cmd -= 0x20;
+    }
+    // check if the command is CW text
+    if (cmd >= cw_mapping_min_ascii && cmd <= cw_mapping_max_ascii) {
+        cw_generator->send_character((char *)WK123_CW_MAPPING[cmd - cw_mapping_min_ascii]);
+        return 0;
+    }
+
+    switch (cmd) {
+        case 0x00:                // Admin command
+            return parse_admin_command(command, reply, maxsize);
+        case 0x01:                // Sidetone Freq
+            if ((wk_version < 3) && (command[1] >= 1) && (command[1] <= 0x0a)) {
+                cw_generator->set_frequency(WK12_FREQUENCY_LIST[command[1]]);
+            } else if ((wk_version == 3) && (command[1] >= 15) && (command[1] <= 125)) {
+                cw_generator->set_frequency(62500/command[1]);
+            }
+            break;
+        case 0x02:                // Speed
+            if ((command[1] >= 5) && (command[1] <= 99)) {   // otherwise the parameter is parsed as next command
+                cw_generator->set_wpm(command[1]);
+            }
+            break;
+        case 0x03:                // Weighting - ignored
+            break;
+        case 0x04:                // PTT Lead-in/Tail - ignored
+            break;
+        case 0x05:                // Speed Pot Setup - ignored
+            break;
+        case 0x06:                // Pause - ignored
+            break;
+        case 0x07:                // Get Speed Pot
+            reply[0] = (cw_generator->get_wpm() & 0x3F) | 0x80;
+            return 1;
+        case 0x08:                // Backspace - ignored
+            break;
+        case 0x09:                // Pin Configuration - selects the keying output (bit 2: key out 1, bit 3: key out 2)
+            if (command[1] & 0x04) {
+                select_generator(0);
+            } else if (command[1] & 0x08) {
+                select_generator(1);
+            }
+            break;
+        case 0x0A:                // Clear Buffer - ignored
+            break;
+        case 0x0B:                // Key Immediate - ignored
+            break;
+        case 0x0C:                // HSCW Speed - ignored
+            break;
+        case 0x0D:                // Farnsworth - ignored
+            break;
+        case 0x0E:                // WinKeyer3 Mode
+            wk_version = 3;
+            break;
+        case 0x0F:                // Load Defaults - ignored
+            break;
+        case 0x10:                // First Extension - ignored
+            break;
+        case 0x11:                // Key Compensation - ignored
+            break;
+        case 0x12:                // Paddle Switchpoint - ignored
+            break;
+        case 0x13:                // ignored
+            break;
+        case 0x14:                // S/W Paddle Input - ignored
+            break;
+        case 0x15:                // WinKeyer3 Status
+            reply[0] = 0xC0;      // always return default status
+            return 1;
+        case 0x16:                // Buffer Pointer - ignored
+            break;
+        case 0x17:                // Dit/Dah Ratio - ignored
+            break;
+        case 0x18:                // PTT Control - ignored
+            break;
+        case 0x19:                // Key Bufferd - ignored
+            break;
+        case 0x1A:                // Wait - ignored
+            break;
+        case 0x1B:                // Merge Letters - ignored
+            break;
+        case 0x1C:                // Speed Change - ignored
+            break;
+        case 0x1D:                // HSCW Speed - ignored
+            break;
+        case 0x1E:                // Cancel Buff Speed - ignored
+            break;
+        case 0x1F:                // Buffered NOP - ignored
+            break;
+        default:                  // unknown command, ignore
+            break;
+    }
+    return 0;
+}
+
+/*
+ * parses the provided message and acts accordingly. A command whose parameters are not complete is kept and
+ * completed by the next message
  * @param message: byte array containing the message received through a serial interface
  * @param length: size of the message
+ * @param maxsize: maximum size of the message buffer
  * @return number of bytes added to the message buffer
  */
 uint32_t WinKeyerParser::parse_message(uint8_t *message, uint32_t length, uint32_t maxsize) {
-    if ((length == 0) || (message == NULL)) {
+    uint32_t pos = 0;                       // next unread byte of the message
+    uint32_t end = length;                  // end of the unread bytes
+    uint32_t replied = 0;                   // reply bytes at the start of the message
+
+    if (message == NULL) {
         return 0;
     }
+    maxsize = maxsize > length ? maxsize : length;
 
-    for (int i = 0; i < length; i++) {
-        if ((message[i] >= 0x61) && (message[i] <= 0x7a)) {
-            // convert small letters to upper case
-            message[i] -= 0x20;
+    while (pos < end) {
+        if ((pending_length == 0) && !command_replies(message[pos]) && (command_size(message + pos, 1) == 1)) {
+            parse_command(message + pos, NULL, 0);  // CW text and commands without parameters and reply
+            pos++;
+            continue;
         }
-        // check if the message starts with CW text
-        if (message[i] >= cw_mapping_min_ascii && message[i] <= cw_mapping_max_ascii) {
-            cw_generator->send_character((char *)WK123_CW_MAPPING[message[i] - cw_mapping_min_ascii]);
-        } else {
-            // check for commands
+        pending[pending_length++] = message[pos++];
 
-            switch (message[i]) {
-                case 0x00:                // Admin command
-                    return parse_admin_command(message, &i, length, maxsize);
-                case 0x01:                // Sidetone Freq
-                    if (length >= 2) {
-                        if ((wk_version < 3) && (message[i+1] >= 1) && (message[i+1] <= 0x0a)) {
-                            cw_generator->set_frequency(WK12_FREQUENCY_LIST[message[i+1]]);
-                        } else if ((wk_version == 3) && (message[i+1] >= 15) && (message[i+1] <= 125)) {
-                            cw_generator->set_frequency(62500/message[i+1]);
-                        }
-                        i++;              // skip parameter in message
-                    }
-                    break;
-                case 0x02:                // Speed
-                    if ((length >= 2) && (message[i+1] >= 5) && (message[i+1] <= 99)) {
-                        cw_generator->set_wpm(message[i+1]);
-                        i++;              // skip parameter in message
-                    }
-                    break;
-                case 0x03:                // Weighting - ignored
-                    break;
-                case 0x04:                // PTT Lead-in/Tail - ignored
-                    break;
-                case 0x05:                // Speed Pot Setup - ignored
-                    break;
-                case 0x06:                // Pause - ignored
-                    break;
-                case 0x07:                // Get Speed Pot
-                    message[0] = (cw_generator->get_wpm() & 0x3F) | 0x80;
-                    return 1;
-                    break;
-                case 0x08:                // Backspace - ignored
-                    break;
-                case 0x09:                // Pin Configuration - ignored
-                    break;
-                case 0x0A:                // Clear Buffer - ignored
-                    break;
-                case 0x0B:                // Key Immediate - ignored
-                    break;
-                case 0x0C:                // HSCW Speed - ignored
-                    break;
-                case 0x0D:                // Farnsworth - ignored
-                    break;
-                case 0x0E:                // WinKeyer3 Mode
-                    wk_version = 3;
-                    break;
-                case 0x0F:                // Load Defaults - ignored
-                    break;
-                case 0x10:                // First Extension - ignored
-                    break;
-                case 0x11:                // Key Compensation - ignored
-                    break;
-                case 0x12:                // Paddle Switchpoint - ignored
-                    break;
-                case 0x13:                // ignored
-                    break;
-                case 0x14:                // S/W Paddle Input - ignored
-                    break;
-                case 0x15:                // WinKeyer3 Status
-                    message[0] = 0xC0;    // always return default status
-                    return 1;
-                case 0x16:                // Buffer Pointer - ignored
-                    break;
-                case 0x17:                // Dit/Dah Ratio - ignored
-                    break;
-                case 0x18:                // PTT Control - ignored
-                    break;
-                case 0x19:                // Key Bufferd - ignored
-                    break;
-                case 0x1A:                // Wait - ignored
-                    break;
-                case 0x1B:                // Merge Letters - ignored
-                    break;
-                case 0x1C:                // Speed Change - ignored
-                    break;
-                case 0x1D:                // HSCW Speed - ignored
-                    break;
-                case 0x1E:                // Cancel Buff Speed - ignored
-                    break;
-                case 0x1F:                // Buffered NOP - ignored
-                    break;
-                default:                  // unknown command, ignore
-                    break;
+        while (pending_length > 0) {
+            uint32_t size = command_size(pending, pending_length);
+            if ((size == 0) || (pending_length < size)) {
+                break;                      // the parameters follow
+            }
+
+            // the command is removed before it is executed, the self-benchmark parses a message of its own
+            uint8_t current[WK_COMMAND_MAX];
+            memcpy(current, pending, sizeof(current));
+            pending_length -= size;
+            memmove(pending, pending + size, pending_length);
+
+            if (command_replies(current[0]) && (end < maxsize)) {
+                // move the unread bytes to the end of the buffer, the replies grow up to them
+                memmove(message + maxsize - (end - pos), message + pos, end - pos);
+                pos = maxsize - (end - pos);
+                end = maxsize;
+            }
+
+            uint8_t discard[WK_COMMAND_MAX];        // replies that do not fit anymore are dropped
+            if (pos - replied >= sizeof(discard)) {
+                replied += parse_command(current, message + replied, pos - replied);
+            } else {
+                parse_command(current, discard, sizeof(discard));
             }
         }
     }
-    return 0;
-}
\ No newline at end of file
+    return replied;
+}
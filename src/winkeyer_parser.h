@@ -32,6 +32,13 @@
 #include <cstring>
 #include "cw_generator.h"
 
+typedef uint32_t (*render_ahead_handler_t)(uint32_t depth);  // sets the render-ahead depth, returns the depth in use
+typedef uint32_t (*benchmark_handler_t)(uint32_t iterations, char *buf, uint32_t maxsize);  // runs the self-benchmark, returns the report length
+typedef uint32_t (*trainer_handler_t)(uint32_t op, uint32_t arg, char *buf, uint32_t maxsize);  // controls the trainer, returns the report length
+
+#define WK_MAX_GENERATORS 2                 // number of keying outputs of the WinKeyer (radios of a two-radio station)
+#define WK_COMMAND_MAX 4                    // longest command including its parameters (admin commands)
+
 /* 
  * class that parses the WinKeyer commands passed through a serial interface
  */
@@ -48,7 +55,9 @@ public:
     WinKeyerParser(CWGenerator *cwgen);
 
     /*
-     * parses the provided message and acts accordingly
+     * parses the provided message and acts accordingly. All commands of the message are executed, a command whose
+     * parameters are not complete is kept and completed by the next message. The replies of all commands are
+     * written to the start of the message buffer
      * @param message: byte array containing the message received through a serial interface
      * @param length: size of the message
      * @param maxsize: maximum size of the message buffer
@@ -56,19 +65,67 @@ public:
      */
     uint32_t parse_message(uint8_t *message, uint32_t length, uint32_t maxsize);
 
+    /*
+     * sets the handler of the render-ahead admin command
+     * @param handler: called with the requested number of packets rendered ahead of the USB stream (0: query)
+     */
+    void set_render_ahead_handler(render_ahead_handler_t handler);
+
+    /*
+     * sets the handler of the self-benchmark admin command
+     * @param handler: called with the number of iterations per kernel (0: default), returns the number of bytes
+     *                 written to buf
+     */
+    void set_benchmark_handler(benchmark_handler_t handler);
+
+    /*
+     * sets the handler of the trainer admin command
+     * @param handler: called with the operation and its argument, returns the number of bytes written to buf
+     */
+    void set_trainer_handler(trainer_handler_t handler);
+
+    /*
+     * sets the generator of a keying output. Output 0 is the generator passed to the constructor
+     * @param index: keying output [0, WK_MAX_GENERATORS - 1]
+     * @param cwgen: generator keying the radio on this output
+     */
+    void set_generator(uint32_t index, CWGenerator *cwgen);
+
+    /*
+     * selects the generator receiving the text and parameter commands and connects the paddles to it. Selected by
+     * the pin configuration command (0x09) like the keying outputs of a WinKeyer, so loggers switching the
+     * transmitting radio of a two-radio station switch the generator
+     * @param index: keying output [0, WK_MAX_GENERATORS - 1], outputs without generator are ignored
+     */
+    void select_generator(uint32_t index);
+
 private:
-    CWGenerator *cw_generator;          // CWGenerator used to send text messages
+    CWGenerator *cw_generator;          // CWGenerator used to send text messages (selected keying output)
+    CWGenerator *cw_generators[WK_MAX_GENERATORS] = {};  // generators of the keying outputs
     uint8_t wk_version = 3;             // current WinKeyer version
+    render_ahead_handler_t render_ahead_handler = NULL;  // handler of the render-ahead depth
+    benchmark_handler_t benchmark_handler = NULL;  // handler of the self-benchmark
+    trainer_handler_t trainer_handler = NULL;  // handler of the pile-up trainer
+    uint8_t pending[WK_COMMAND_MAX];    // bytes of a command whose parameters were not received yet
+    uint32_t pending_length = 0;        // number of bytes in pending
+
+    /*
+     * executes a complete command
+     * @param command: command including its parameters, command[0] is the CW text or command byte
+     * @param reply: buffer the reply is written to
+     * @param maxsize: size of the reply buffer
+     * @return number of bytes written to the reply buffer
+     */
+    uint32_t parse_command(const uint8_t *command, uint8_t *reply, uint32_t maxsize);
 
     /*
      * parses admin commands
-     * @param message message to parse. message[0] corresponds to <0> which indicates an admin command
-     * @param offset start position of admin message
-     * @param length length of the provided message
-     * @param maxsize buffer size
+     * @param command complete admin command. command[0] corresponds to <0> which indicates an admin command
+     * @param reply buffer the reply is written to
+     * @param maxsize size of the reply buffer
      * @return number of bytes added to the result;
      */
-    uint32_t parse_admin_command(uint8_t *message, int *offset, uint32_t length, uint32_t maxsize);
+    uint32_t parse_admin_command(const uint8_t *command, uint8_t *reply, uint32_t maxsize);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+#
+# The MIT License (MIT)
+#
+# Copyright (c) 2022 Jochen Schaeuble
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+
+"""
+Reports the functions and tables of the audio hot path that are located in XIP flash.
+
+usage: hotpath_check.py [--strict] <picoditdah.elf> [root ...]
+
+Starting at the USB audio callbacks, the paddle interrupt and the keyer loop (or the given roots), all
+functions reachable by direct calls and tail calls are collected from the disassembly. Every
+reached function in flash and every flash object whose address is loaded by a reached function
+in RAM is reported with the call path. Calls through function pointers are not followed, their
+targets must be given as roots. With --strict the exit code is 1 if anything is reported.
+"""
+
+import os
+import re
+import subprocess
+import sys
+
+# entry points of the audio path: USB callbacks, the handlers they call through pointers, the paddle interrupt,
+# the keyer loop on core 1 and its render task called by the scheduler
+HOT_ROOTS = [
+    "tud_audio_tx_done_pre_load_cb",
+    "tud_audio_tx_done_post_load_cb",
+    "on_usb_microphone_tx_pre",
+    "paddle_gpio_callback",
+    "keyer_core_main",
+    "keyer_render_task",
+]
+
+FLASH_START = 0x10000000
+FLASH_END = 0x15000000
+RAM_START = 0x20000000
+
+FUNC_RE = re.compile(r"^([0-9a-f]{8}) <(.+)>:$")
+CALL_RE = re.compile(r"\s(bl|blx|b|b\.n|b\.w|b[a-z]{2}(?:\.[nw])?)\s+([0-9a-f]+) <(.+)>\s*$")
+WORD_RE = re.compile(r"\.word\s+0x([0-9a-f]{8})")
+
+
+def region(addr):
+    if FLASH_START <= addr < FLASH_END:
+        return "flash"
+    if addr >= RAM_START:
+        return "ram"
+    return "rom"
+
+
+def base_name(name):
+    """returns the function name without signature, as used for the roots"""
+    name = name.split("(")[0]
+    return name
+
+
+def callee_name(name):
+    """returns the called function of a branch target or None for a branch within a function"""
+    return None if "+0x" in name else name
+
+
+def is_veneer(name):
+    """linker veneers for calls between RAM and flash load the target address from a literal"""
+    return re.match(r"^__.+_veneer$", name) is not None
+
+
+def parse_disassembly(lines):
+    """returns {name: (address, [callees], [loaded addresses])} of all functions of the disassembly"""
+    functions = {}
+    current = None
+    for line in lines:
+        line = line.rstrip()
+        m = FUNC_RE.match(line)
+        if m:
+            current = m.group(2)
+            functions[current] = (int(m.group(1), 16), [], [])
+            continue
+        if current is None:
+            continue
+        m = CALL_RE.search(line)
+        if m:
+            callee = callee_name(m.group(3))
+            if callee and callee != current and callee not in functions[current][1]:
+                functions[current][1].append(callee)
+            continue
+        m = WORD_RE.search(line)
+        if m:
+            functions[current][2].append(int(m.group(1), 16))
+    return functions
+
+
+def load_objects(elf):
+    """returns a list of (address, size, name) of all data objects in flash"""
+    nm = os.environ.get("NM", "arm-none-eabi-nm")
+    out = subprocess.run([nm, "-C", "-S", "--defined-only", elf], check=True, capture_output=True, text=True).stdout
+    objects = []
+    for line in out.splitlines():
+        parts = line.split(maxsplit=3)
+        if len(parts) == 4 and parts[2] in "rRdD":
+            addr = int(parts[0], 16)
+            if region(addr) == "flash":
+                objects.append((addr, int(parts[1], 16), parts[3]))
+    return objects
+
+
+def find_object(objects, addr):
+    for start, size, name in objects:
+        if start <= addr < start + size:
+            return name
+    return None
+
+
+def check(functions, objects, roots):
+    """returns the list of report lines for the hot path below roots"""
+    by_base = {}
+    by_addr = {}
+    for name, (addr, _, _) in functions.items():
+        by_base.setdefault(base_name(name), name)
+        by_addr.setdefault(addr, name)
+
+    report = []
+    paths = {}
+    todo = []
+    for root in roots:
+        name = root if root in functions else by_base.get(root)
+        if name is None:
+            report.append("root not found: %s" % root)
+            continue
+        paths[name] = [base_name(name)]
+        todo.append(name)
+
+    while todo:
+        name = todo.pop(0)
+        addr, callees, words = functions[name]
+        if is_veneer(name):
+            callees = [by_addr[w & ~1] for w in words if (w & ~1) in by_addr]
+        elif region(addr) == "flash":
+            report.append("function in flash: %s  (%s)" % (name, " -> ".join(paths[name])))
+        elif region(addr) == "ram":
+            for word in words:
+                obj = find_object(objects, word)
+                if obj:
+                    report.append("table in flash: %s  (%s)" % (obj, " -> ".join(paths[name])))
+        for callee in callees:
+            target = callee if callee in functions else by_base.get(base_name(callee))
+            if target and target not in paths:
+                paths[target] = paths[name] + ([] if is_veneer(target) else [base_name(target)])
+                todo.append(target)
+    return report
+
+
+def main():
+    args = sys.argv[1:]
+    strict = "--strict" in args
+    args = [a for a in args if a != "--strict"]
+    if not args:
+        print(__doc__)
+        return 1
+
+    objdump = os.environ.get("OBJDUMP", "arm-none-eabi-objdump")
+    out = subprocess.run([objdump, "-d", "-C", args[0]], check=True, capture_output=True, text=True).stdout
+    functions = parse_disassembly(out.splitlines())
+    objects = load_objects(args[0])
+
+    report = check(functions, objects, args[1:] or HOT_ROOTS)
+    for line in report:
+        print("hotpath: " + line)
+    print("hotpath: %d function(s) or table(s) of the audio path in flash" % len(report))
+    return 1 if strict and report else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+#
+# The MIT License (MIT)
+#
+# Copyright (c) 2022 Jochen Schaeuble
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+
+"""
+Symbolises the dump of the PicoDitDah PC profiler (admin command 0x1E, op 2).
+
+usage: pcprof_symbolize.py <picoditdah.elf> [dump.txt]
+
+The dump consists of header lines "pcprof samples=<core 0>/<core 1> ... rom=<size> flash=<size> ram=<size>"
+followed by "<address> <count core 0> <count core 1>" lines. The samples of each bucket are attributed to
+the function symbols overlapping the bucket, proportional to the overlap. The report lists the share of
+all samples and the samples of each core per function.
+"""
+
+import bisect
+import os
+import re
+import subprocess
+import sys
+
+
+def load_symbols(elf):
+    """returns a sorted list of (address, size, name) of all function symbols in the ELF file"""
+    nm = os.environ.get("NM", "arm-none-eabi-nm")
+    out = subprocess.run([nm, "-C", "-S", "--defined-only", elf], check=True, capture_output=True, text=True).stdout
+    symbols = []
+    for line in out.splitlines():
+        parts = line.split(maxsplit=3)
+        if len(parts) == 4 and parts[2] in "tTwW":
+            addr = int(parts[0], 16) & ~1           # remove thumb bit
+            symbols.append((addr, int(parts[1], 16), parts[3]))
+    symbols.sort()
+    return symbols
+
+
+def parse_dump(lines):
+    """returns the bucket sizes per region and the list of (address, [count core 0, count core 1]) tuples"""
+    sizes = {}
+    buckets = []
+    for line in lines:
+        line = line.strip()
+        if line.startswith("pcprof"):
+            for key, value in re.findall(r"(\w+)=(\d+)", line):
+                if key in ("rom", "flash", "ram"):
+                    sizes[key] = int(value)
+        elif re.match(r"^[0-9a-fA-F]{8} \d+( \d+)?$", line):
+            fields = line.split()
+            counts = [int(c) for c in fields[1:]] + [0]     # dumps of older firmware sample core 0 only
+            buckets.append((int(fields[0], 16), counts[:2]))
+    return sizes, buckets
+
+
+def bucket_size(sizes, addr):
+    if addr < 0x10000000:
+        return sizes.get("rom", 256)
+    if addr < 0x20000000:
+        return sizes.get("flash", 64)
+    return sizes.get("ram", 2048)
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        return 1
+
+    symbols = load_symbols(sys.argv[1])
+    starts = [s[0] for s in symbols]
+    lines = open(sys.argv[2]).readlines() if len(sys.argv) > 2 else sys.stdin.readlines()
+    sizes, buckets = parse_dump(lines)
+
+    totals = {}
+    for addr, counts in buckets:
+        size = bucket_size(sizes, addr)
+        end = addr + size
+        attributed = 0.0
+        i = max(bisect.bisect_right(starts, addr) - 1, 0)
+        while i < len(symbols) and symbols[i][0] < end:
+            sym_start, sym_size, name = symbols[i]
+            overlap = min(end, sym_start + max(sym_size, 1)) - max(addr, sym_start)
+            if overlap > 0:
+                entry = totals.setdefault(name, [0.0, 0.0])
+                for core in range(2):
+                    entry[core] += counts[core] * overlap / size
+                attributed += overlap / size
+            i += 1
+        if (counts[0] + counts[1]) * (1.0 - attributed) > 0.5:
+            name = "<rom>" if addr < 0x10000000 else "<unknown 0x%08x>" % addr
+            entry = totals.setdefault(name, [0.0, 0.0])
+            for core in range(2):
+                entry[core] += counts[core] * (1.0 - attributed)
+
+    total = sum(entry[0] + entry[1] for entry in totals.values())
+    if total == 0:
+        print("no samples")
+        return 0
+    print("%7s %8s %8s  %s" % ("share", "core0", "core1", "function"))
+    for name, entry in sorted(totals.items(), key=lambda x: -(x[1][0] + x[1][1])):
+        print("%6.2f%% %8.1f %8.1f  %s" % (100.0 * (entry[0] + entry[1]) / total, entry[0], entry[1], name))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())